@@ -2,9 +2,29 @@
 #ifndef OCTREE_CORE_H
 #define OCTREE_CORE_H
 
-#include "PotreeLoader\Octree.h"
-#include "PotreeLoader\OctreeData.h"
-#include "PotreeLoader\OctreeFileReader.h"
-#include "PotreeLoader\OctreeLoader.h"
+#include "PotreeLoader/Octree.h"
+#include "PotreeLoader/OctreeData.h"
+#include "PotreeLoader/OctreeFileReader.h"
+#include "PotreeLoader/PlatformFile.h"
+#include "PotreeLoader/ByteSource.h"
+#include "PotreeLoader/HttpByteSource.h"
+#include "PotreeLoader/PackedOctreeFile.h"
+#include "PotreeLoader/OctreeArchive.h"
+#include "PotreeLoader/HierarchySnapshot.h"
+#include "PotreeLoader/OctreeNodeKey.h"
+#include "PotreeLoader/OctreeNodeBounds.h"
+#include "PotreeLoader/OctreeNodeIndex.h"
+#include "PotreeLoader/OctreeTraversal.h"
+#include "PotreeLoader/OctreeRegionQuery.h"
+#include "PotreeLoader/OctreeNodeTable.h"
+#include "PotreeLoader/HierarchyView.h"
+#include "PotreeLoader/OctreeFrustumCulling.h"
+#include "PotreeLoader/OctreeLodSelection.h"
+#include "PotreeLoader/OctreeDensitySelection.h"
+#include "PotreeLoader/OctreeRayPick.h"
+#include "PotreeLoader/OctreeAsyncReader.h"
+#include "PotreeLoader/OctreeReadPlanner.h"
+#include "PotreeLoader/OctreePrefetcher.h"
+#include "PotreeLoader/OctreeLoader.h"
 
 #endif
\ No newline at end of file
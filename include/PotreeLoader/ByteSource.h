@@ -0,0 +1,159 @@
+#pragma once
+#ifndef BYTESOURCE_H
+#define BYTESOURCE_H
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include <filesystem>
+#include "PlatformFile.h"
+#include "OctreeAsyncReader.h"
+
+// Random access, read-only source of bytes, e.g. one of the octree files on disk, in memory or behind an HTTP server.
+// All methods have to be thread-safe
+class ByteSource
+{
+public:
+	virtual ~ByteSource() = default;
+
+	// Name for error messages, e.g. the path or URL
+	virtual std::string Name() const = 0;
+
+	virtual uint64_t Size() const = 0;
+
+	// Reads up to byte_size bytes starting at byte_start. Returns the number of bytes actually read
+	virtual size_t ReadAt(uint64_t byte_start, uint64_t byte_size, uint8_t* target) const = 0;
+
+	// Pointer to the whole content if the source is contiguous in memory, nullptr otherwise
+	virtual const uint8_t* Data() const
+	{
+		return nullptr;
+	}
+
+	// Reads many ranges and calls the callback for each of them, in any order but never concurrently.
+	// Sources which can keep several reads in flight override this
+	virtual void Read(const std::vector<AsyncReadRequest>& requests, const AsyncReadCallback& callback, const AsyncReadOptions& options = AsyncReadOptions()) const
+	{
+		(void)options;
+		std::vector<uint8_t> buffer;
+
+		for (const auto& request : requests)
+		{
+			if (buffer.size() < request.byteSize) {
+				buffer.resize(static_cast<size_t>(request.byteSize));
+			}
+
+			const size_t bytes_read = ReadAt(request.byteOffset, request.byteSize, buffer.data());
+			callback(request.id, buffer.data(), bytes_read);
+		}
+	}
+
+	// Reads the whole source
+	std::vector<uint8_t> ReadAll() const
+	{
+		std::vector<uint8_t> content(static_cast<size_t>(Size()));
+		content.resize(ReadAt(0, content.size(), content.data()));
+		return content;
+	}
+};
+
+// Local file read with positional reads through one persistent handle
+class FileByteSource : public ByteSource
+{
+	std::string file_path;
+	uint64_t file_size;
+	uint64_t file_offset = 0;
+	std::shared_ptr<PositionalFile> file;
+	std::shared_ptr<ReadWorkerPool> read_workers = std::make_shared<ReadWorkerPool>();
+
+public:
+	FileByteSource(const std::string& path)
+		: file_path(path), file_size(std::filesystem::file_size(path)), file(std::make_shared<PositionalFile>(path)) {}
+
+	// Part of a file at [offset, offset + size), e.g. a section of a packed octree file or an archive entry
+	FileByteSource(const std::string& path, uint64_t offset, uint64_t size)
+		: file_path(path), file_size(size), file_offset(offset), file(std::make_shared<PositionalFile>(path))
+	{
+		if (offset + size > std::filesystem::file_size(path)) {
+			throw std::out_of_range("Byte range reaches beyond the end of the file: " + path);
+		}
+	}
+
+	std::string Name() const override
+	{
+		return file_path;
+	}
+
+	uint64_t Size() const override
+	{
+		return file_size;
+	}
+
+	size_t ReadAt(uint64_t byte_start, uint64_t byte_size, uint8_t* target) const override
+	{
+		if (byte_start >= file_size) {
+			return 0;
+		}
+
+		return file->readAt(file_offset + byte_start, (std::min)(byte_start + byte_size, file_size) - byte_start, target);
+	}
+
+	void Read(const std::vector<AsyncReadRequest>& requests, const AsyncReadCallback& callback, const AsyncReadOptions& options = AsyncReadOptions()) const override
+	{
+		// Translate to positions in the file, without reaching beyond the end of the range
+		std::vector<AsyncReadRequest> fileRequests(requests);
+		for (auto& request : fileRequests)
+		{
+			const uint64_t start = (std::min)(request.byteOffset, file_size);
+			request.byteSize = (std::min)(request.byteSize, file_size - start);
+			request.byteOffset = file_offset + start;
+		}
+
+		OctreeAsyncReader(file_path, file, read_workers).Read(fileRequests, callback, options);
+	}
+};
+
+// Bytes held in memory, e.g. a dataset which was downloaded or generated in place
+class MemoryByteSource : public ByteSource
+{
+	std::string source_name;
+	std::shared_ptr<const std::vector<uint8_t>> content;
+
+public:
+	MemoryByteSource(std::vector<uint8_t> bytes, const std::string& name = "memory")
+		: source_name(name), content(std::make_shared<const std::vector<uint8_t>>(std::move(bytes))) {}
+
+	MemoryByteSource(std::shared_ptr<const std::vector<uint8_t>> bytes, const std::string& name = "memory")
+		: source_name(name), content(std::move(bytes)) {}
+
+	std::string Name() const override
+	{
+		return source_name;
+	}
+
+	uint64_t Size() const override
+	{
+		return content->size();
+	}
+
+	const uint8_t* Data() const override
+	{
+		return content->data();
+	}
+
+	size_t ReadAt(uint64_t byte_start, uint64_t byte_size, uint8_t* target) const override
+	{
+		if (byte_start >= content->size()) {
+			return 0;
+		}
+
+		const size_t bytes_to_read = static_cast<size_t>((std::min)(byte_start + byte_size, static_cast<uint64_t>(content->size())) - byte_start);
+		memcpy(target, content->data() + byte_start, bytes_to_read);
+		return bytes_to_read;
+	}
+};
+
+#endif
@@ -0,0 +1,228 @@
+#pragma once
+#ifndef HIERARCHYSNAPSHOT_H
+#define HIERARCHYSNAPSHOT_H
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <filesystem>
+#include <type_traits>
+#include "PlatformFile.h"
+
+// How a snapshot is checked against the files it was built from. SizeAndTime compares file size and modification time,
+// Hash additionally hashes the metadata and hierarchy files, which costs a read of both
+enum class SnapshotValidation {
+	SizeAndTime = 0,
+	Hash = 1,
+};
+
+// 64 bit FNV-1a over 8 byte words, with the tail bytes as one last word
+inline uint64_t HashFileContents(const std::string& path)
+{
+	constexpr uint64_t prime = 0x100000001b3ull;
+	uint64_t hash = 0xcbf29ce484222325ull;
+
+	PositionalFile file(path);
+	const uint64_t fileSize = std::filesystem::file_size(path);
+	std::vector<uint8_t> buffer(1 << 20);
+
+	for (uint64_t position = 0; position < fileSize;)
+	{
+		const size_t bytesRead = file.readAt(position, (std::min)(static_cast<uint64_t>(buffer.size()), fileSize - position), buffer.data());
+		if (bytesRead == 0) {
+			throw std::runtime_error("Could not read file: " + path);
+		}
+
+		size_t i = 0;
+		for (; i + 8 <= bytesRead; i += 8)
+		{
+			uint64_t word;
+			memcpy(&word, buffer.data() + i, sizeof(word));
+			hash = (hash ^ word) * prime;
+		}
+		if (i < bytesRead)
+		{
+			uint64_t word = 0;
+			memcpy(&word, buffer.data() + i, bytesRead - i);
+			hash = (hash ^ word) * prime;
+		}
+
+		position += bytesRead;
+	}
+
+	return hash;
+}
+
+// Identity of a source file of a snapshot
+struct SnapshotSourceStamp
+{
+	std::string path;
+	uint64_t size = 0;
+	int64_t modified = 0; // Modification time in file clock ticks
+	uint64_t hash = 0;    // Only set for hashed sources
+
+	static SnapshotSourceStamp Of(const std::string& path, bool hashContents)
+	{
+		SnapshotSourceStamp stamp;
+		stamp.path = path;
+		stamp.size = std::filesystem::file_size(path);
+		stamp.modified = static_cast<int64_t>(std::filesystem::last_write_time(path).time_since_epoch().count());
+		stamp.hash = hashContents ? HashFileContents(path) : 0;
+		return stamp;
+	}
+
+	// Whether the file is still the one the snapshot was built from. A stored hash of 0 is not checked
+	bool Matches(SnapshotValidation validation) const
+	{
+		std::error_code error;
+		const uint64_t currentSize = std::filesystem::file_size(path, error);
+		if (error || currentSize != size) {
+			return false;
+		}
+
+		const auto currentTime = std::filesystem::last_write_time(path, error);
+		if (error || static_cast<int64_t>(currentTime.time_since_epoch().count()) != modified) {
+			return false;
+		}
+
+		return validation != SnapshotValidation::Hash || hash == 0 || HashFileContents(path) == hash;
+	}
+};
+
+// Header of a hierarchy snapshot file, which holds the parsed metadata and the node table of a dataset, see Octree::SaveSnapshot.
+// Layout: 64 byte header, metadata block, then the node table arrays, each starting at a 64 byte boundary.
+// Header: magic "POTRSNAP", u32 version, u32 reserved, u64 metadata offset, u64 metadata size, u64 node count. Little endian
+struct HierarchySnapshotHeader
+{
+	static constexpr char magic[8] = { 'P', 'O', 'T', 'R', 'S', 'N', 'A', 'P' };
+	static constexpr uint32_t currentVersion = 3;
+	static constexpr uint64_t headerSize = 64;
+	static constexpr uint64_t arrayAlignment = 64;
+
+	uint32_t version = currentVersion;
+	uint64_t metadataOffset = headerSize;
+	uint64_t metadataSize = 0;
+	uint64_t nodeCount = 0;
+
+	void Serialize(uint8_t* target) const
+	{
+		memset(target, 0, headerSize);
+		memcpy(target, magic, sizeof(magic));
+		memcpy(target + 8, &version, sizeof(version));
+		memcpy(target + 16, &metadataOffset, sizeof(metadataOffset));
+		memcpy(target + 24, &metadataSize, sizeof(metadataSize));
+		memcpy(target + 32, &nodeCount, sizeof(nodeCount));
+	}
+
+	static HierarchySnapshotHeader Parse(const uint8_t* source, size_t size, const std::string& name)
+	{
+		if (size < headerSize || memcmp(source, magic, sizeof(magic)) != 0) {
+			throw std::runtime_error("Not a hierarchy snapshot: " + name);
+		}
+
+		HierarchySnapshotHeader header;
+		memcpy(&header.version, source + 8, sizeof(header.version));
+		memcpy(&header.metadataOffset, source + 16, sizeof(header.metadataOffset));
+		memcpy(&header.metadataSize, source + 24, sizeof(header.metadataSize));
+		memcpy(&header.nodeCount, source + 32, sizeof(header.nodeCount));
+
+		if (header.version != currentVersion) {
+			throw std::runtime_error("Unsupported hierarchy snapshot version " + std::to_string(header.version) + ": " + name);
+		}
+		if (header.metadataOffset > size || header.metadataSize > size - header.metadataOffset) {
+			throw std::runtime_error("Hierarchy snapshot metadata reaches beyond the end of the file: " + name);
+		}
+		if (header.nodeCount > size) {
+			// Every node takes several bytes, checked here so the array offsets cannot overflow
+			throw std::runtime_error("Hierarchy snapshot node count exceeds the file size: " + name);
+		}
+
+		return header;
+	}
+
+	static uint64_t Align(uint64_t position)
+	{
+		return (position + arrayAlignment - 1) / arrayAlignment * arrayAlignment;
+	}
+
+	// Offsets of the node table arrays in OctreeNodeTable member order, followed by the end of the file
+	std::vector<uint64_t> ArrayOffsets(const std::vector<size_t>& elementSizes) const
+	{
+		std::vector<uint64_t> offsets;
+		uint64_t position = metadataOffset + metadataSize;
+
+		for (size_t elementSize : elementSizes)
+		{
+			position = Align(position);
+			offsets.push_back(position);
+			position += elementSize * nodeCount;
+		}
+
+		offsets.push_back(position);
+		return offsets;
+	}
+};
+
+// Appends little endian values to the metadata block of a snapshot
+class SnapshotWriter
+{
+public:
+	std::vector<uint8_t> bytes;
+
+	template<typename T>
+	void Put(const T& value)
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "Only plain values can be written");
+		const size_t position = bytes.size();
+		bytes.resize(position + sizeof(T));
+		memcpy(bytes.data() + position, &value, sizeof(T));
+	}
+
+	void PutString(const std::string& value)
+	{
+		Put<uint64_t>(value.size());
+		bytes.insert(bytes.end(), value.begin(), value.end());
+	}
+};
+
+// Reads the values written by SnapshotWriter, with bounds checks
+class SnapshotReader
+{
+	const uint8_t* source;
+	size_t size;
+	size_t position = 0;
+	std::string name;
+
+	void Require(size_t byteCount)
+	{
+		if (byteCount > size - position) {
+			throw std::runtime_error("Hierarchy snapshot metadata is truncated: " + name);
+		}
+	}
+
+public:
+	SnapshotReader(const uint8_t* source, size_t size, std::string name) : source(source), size(size), name(std::move(name)) {}
+
+	template<typename T>
+	T Get()
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "Only plain values can be read");
+		Require(sizeof(T));
+		T value;
+		memcpy(&value, source + position, sizeof(T));
+		position += sizeof(T);
+		return value;
+	}
+
+	std::string GetString()
+	{
+		const uint64_t length = Get<uint64_t>();
+		Require(static_cast<size_t>(length));
+		std::string value(reinterpret_cast<const char*>(source + position), static_cast<size_t>(length));
+		position += static_cast<size_t>(length);
+		return value;
+	}
+};
+
+#endif
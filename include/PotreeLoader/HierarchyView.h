@@ -0,0 +1,357 @@
+#pragma once
+#ifndef HIERARCHYVIEW_H
+#define HIERARCHYVIEW_H
+#include <bit>
+#include <memory>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <functional>
+#include "../ThirdParty/PotreeConverter/Geometry.h"
+#include "PlatformFile.h"
+#include "OctreeNodeKey.h"
+#include "OctreeTraversal.h"
+#include "OctreeNodeBounds.h"
+
+class HierarchyView;
+
+// Records are 22 bytes, so their fields are at arbitrary alignment. memcpy compiles to a plain load where that is allowed
+template<typename T>
+inline T LoadUnaligned(const uint8_t* source)
+{
+	T value;
+	memcpy(&value, source, sizeof(T));
+	return value;
+}
+
+// Handle to one node of a HierarchyView: the index of its record in hierarchy.bin plus the chunk holding the record.
+// Proxy records are resolved to the first record of their chunk. Cheap to copy, valid as long as the view lives
+class HierarchyViewNode
+{
+	friend class HierarchyView;
+
+	const HierarchyView* view = nullptr;
+	uint64_t record_index = 0;
+	uint64_t chunk_first = 0;
+	uint64_t chunk_records = 0;
+	OctreeNodeKey node_key;
+
+public:
+	HierarchyViewNode() = default;
+
+	bool valid() const { return view != nullptr; }
+
+	// Index of the node's record, i.e. its byte position in hierarchy.bin divided by 22
+	uint64_t record() const { return record_index; }
+	const OctreeNodeKey& key() const { return node_key; }
+	int level() const { return node_key.level(); }
+	int octant() const { return node_key.octant(); }
+	std::string name() const { return node_key.name(); }
+
+	inline uint8_t nodeType() const;
+	inline uint8_t childMask() const;
+	inline uint32_t numPoints() const;
+	inline uint64_t byteOffset() const;
+	inline uint64_t byteSize() const;
+	inline double spacing() const;
+	inline geometry::BoundingBox boundingBox() const;
+
+	bool hasChildren() const { return childMask() != 0; }
+	int childCount() const { return std::popcount(childMask()); }
+
+	// n-th existing child in octant order. Finds the child by summing the child counts of the records before this one
+	// in its chunk, so traversals of the view are faster than walking nodes with child()
+	inline HierarchyViewNode child(int n) const;
+	inline HierarchyViewNode childAt(int octant) const; // Invalid node if the octant has no child
+
+	bool operator==(const HierarchyViewNode& rhs) const
+	{
+		return view == rhs.view && record_index == rhs.record_index;
+	}
+};
+
+// Read-only hierarchy that maps hierarchy.bin and interprets the records in place, without creating node objects.
+// Answers which nodes exist and where their bytes are. Traversals visit nodes in the same order as OctreeGeometryNode::traverse
+class HierarchyView
+{
+	friend class HierarchyViewNode;
+
+	std::unique_ptr<MappedFile> mapping;
+	const uint8_t* records = nullptr;
+	uint64_t hierarchy_size = 0;
+	uint64_t first_chunk_size = 0;
+	geometry::BoundingBox root_box;
+	double root_spacing = 0.0;
+
+public:
+	static constexpr uint64_t bytesPerRecord = 22;
+	static constexpr uint8_t proxyType = 2;
+
+	// Maps the hierarchy at [offset, offset + size) of the file, the whole file if size is 0
+	HierarchyView(const std::string& hierarchyPath, uint64_t firstChunkSize, const geometry::BoundingBox& rootBoundingBox, double rootSpacing,
+		uint64_t offset = 0, uint64_t size = 0)
+		: mapping(std::make_unique<MappedFile>(hierarchyPath)), first_chunk_size(firstChunkSize), root_box(rootBoundingBox), root_spacing(rootSpacing)
+	{
+		if (size == 0 && offset <= mapping->size()) {
+			size = mapping->size() - offset;
+		}
+		if (offset > mapping->size() || size > mapping->size() - offset) {
+			throw std::out_of_range("Hierarchy region reaches beyond the end of the file: " + hierarchyPath);
+		}
+		if (firstChunkSize > size) {
+			throw std::out_of_range("First hierarchy chunk reaches beyond the end of the hierarchy: " + hierarchyPath);
+		}
+
+		records = mapping->data() + offset;
+		hierarchy_size = size;
+	}
+
+	// Hierarchy of a loaded octree. The octree only needs its metadata, so loading it with HierarchyLoading::Lazy is enough
+	explicit HierarchyView(const Octree& octree)
+		: HierarchyView(octree.files.hierarchy, static_cast<uint64_t>(octree.hierarchy.firstChunkSize), octree.geometry.boundingBox, octree.geometry.spacing,
+			octree.files.hierarchyOffset, octree.files.hierarchySize)
+	{
+	}
+
+	HierarchyView(const HierarchyView&) = delete;
+	HierarchyView& operator=(const HierarchyView&) = delete;
+
+	uint64_t RecordCount() const
+	{
+		return hierarchy_size / bytesPerRecord;
+	}
+
+	// Nodes reachable from the root, like OctreeGeometry::traversableNodes. Every record except proxies is a node,
+	// a proxy is the same node as the first record of its chunk. One pass over the type bytes
+	uint64_t CountNodes() const
+	{
+		uint64_t proxies = 0;
+		for (uint64_t record = 0; record < RecordCount(); ++record) {
+			proxies += records[record * bytesPerRecord] == proxyType;
+		}
+		return RecordCount() - proxies;
+	}
+
+	HierarchyViewNode Root() const
+	{
+		if (first_chunk_size < bytesPerRecord) {
+			return HierarchyViewNode();
+		}
+		return MakeNode(0, first_chunk_size / bytesPerRecord, 0, OctreeNodeKey::Root());
+	}
+
+	// Descends from the root along the key's octants. Invalid node if the node does not exist
+	HierarchyViewNode Find(const OctreeNodeKey& key) const
+	{
+		HierarchyViewNode node = Root();
+		for (int depth = 1; depth <= key.level() && node.valid(); ++depth) {
+			node = node.childAt(key.octant(depth));
+		}
+		return node;
+	}
+
+	// Depth-first pre-order, like OctreeGeometryNode::traverse
+	template<typename Callback>
+	void traverse(Callback&& callback) const
+	{
+		traverse_conditional(callback, [](const HierarchyViewNode&, int) { return true; });
+	}
+
+	// Depth-first pre-order over the nodes within the level range, without entering deeper subtrees
+	template<typename Callback>
+	void traverse(Callback&& callback, const LevelRange& levels) const
+	{
+		traverse_conditional(callback, [](const HierarchyViewNode&, int) { return true; }, levels);
+	}
+
+	// Depth-first pre-order. Subtrees of nodes which fail the condition are skipped.
+	// Child positions are computed once per visited chunk and dropped when the traversal leaves the chunk
+	template<typename Callback, typename Condition>
+	void traverse_conditional(Callback&& callback, Condition&& condition, const LevelRange& levels = LevelRange()) const
+	{
+		const HierarchyViewNode root = Root();
+		if (!root.valid()) {
+			return;
+		}
+
+		struct Frame
+		{
+			HierarchyViewNode node;
+			std::shared_ptr<const std::vector<uint32_t>> childStarts; // Of the node's chunk, shared with the other nodes of the chunk
+		};
+
+		std::vector<Frame> stack{ { root, nullptr } };
+		while (!stack.empty())
+		{
+			Frame frame = std::move(stack.back());
+			stack.pop_back();
+
+			const HierarchyViewNode& node = frame.node;
+			const int level = node.level();
+			if (level > levels.maxLevel || !condition(node, level)) {
+				continue;
+			}
+
+			if (level >= levels.minLevel) {
+				callback(node, level);
+			}
+
+			const uint8_t mask = node.childMask();
+			if (mask == 0 || level == levels.maxLevel) {
+				continue;
+			}
+
+			if (!frame.childStarts) {
+				frame.childStarts = std::make_shared<const std::vector<uint32_t>>(ChildStarts(node.chunk_first, node.chunk_records));
+			}
+
+			// Reverse order, so children are visited in octant order
+			uint64_t childLocal = (*frame.childStarts)[node.record_index - node.chunk_first] + static_cast<uint64_t>(std::popcount(mask));
+			for (int octant = 8; octant-- > 0;)
+			{
+				if (((mask >> octant) & 1) == 0) {
+					continue;
+				}
+
+				const HierarchyViewNode child = MakeNode(node.chunk_first, node.chunk_records, --childLocal, node.node_key.child(octant));
+				const bool sameChunk = child.chunk_first == node.chunk_first;
+				stack.push_back({ child, sameChunk ? frame.childStarts : nullptr });
+			}
+		}
+	}
+
+	// Raw record fields, record being the index of the record within the hierarchy
+	uint8_t Type(uint64_t record) const { return records[record * bytesPerRecord]; }
+	uint8_t ChildMask(uint64_t record) const { return records[record * bytesPerRecord + 1]; }
+	uint32_t NumPoints(uint64_t record) const { return LoadUnaligned<uint32_t>(records + record * bytesPerRecord + 2); }
+	uint64_t ByteOffset(uint64_t record) const { return LoadUnaligned<uint64_t>(records + record * bytesPerRecord + 6); }
+	uint64_t ByteSize(uint64_t record) const { return LoadUnaligned<uint64_t>(records + record * bytesPerRecord + 14); }
+
+private:
+	// Node of the record at index local of a chunk. Proxy records are replaced by the first record of their chunk
+	HierarchyViewNode MakeNode(uint64_t chunkFirst, uint64_t chunkRecords, uint64_t local, const OctreeNodeKey& key) const
+	{
+		if (local >= chunkRecords) {
+			throw std::out_of_range("Hierarchy child record lies outside of its chunk: " + key.name());
+		}
+
+		HierarchyViewNode node;
+		node.view = this;
+		node.record_index = chunkFirst + local;
+		node.chunk_first = chunkFirst;
+		node.chunk_records = chunkRecords;
+		node.node_key = key;
+
+		if (Type(node.record_index) == proxyType)
+		{
+			const uint64_t chunkOffset = ByteOffset(node.record_index);
+			const uint64_t chunkSize = ByteSize(node.record_index);
+			if (chunkOffset % bytesPerRecord != 0 || chunkSize < bytesPerRecord || chunkOffset > hierarchy_size || chunkSize > hierarchy_size - chunkOffset) {
+				throw std::out_of_range("Hierarchy chunk of proxy node reaches beyond the hierarchy: " + key.name());
+			}
+
+			node.record_index = chunkOffset / bytesPerRecord;
+			node.chunk_first = node.record_index;
+			node.chunk_records = chunkSize / bytesPerRecord;
+		}
+
+		return node;
+	}
+
+	// Local index of the first child of every record of a chunk. Children of non-proxy records follow the first record
+	// in record order
+	std::vector<uint32_t> ChildStarts(uint64_t chunkFirst, uint64_t chunkRecords) const
+	{
+		std::vector<uint32_t> starts(static_cast<size_t>(chunkRecords));
+		uint32_t next = 1;
+		for (uint64_t local = 0; local < chunkRecords; ++local)
+		{
+			starts[static_cast<size_t>(local)] = next;
+			if (Type(chunkFirst + local) != proxyType) {
+				next += static_cast<uint32_t>(std::popcount(ChildMask(chunkFirst + local)));
+			}
+		}
+		return starts;
+	}
+
+	uint64_t ChildStart(uint64_t chunkFirst, uint64_t local) const
+	{
+		uint64_t next = 1;
+		for (uint64_t before = 0; before < local; ++before)
+		{
+			if (Type(chunkFirst + before) != proxyType) {
+				next += static_cast<uint64_t>(std::popcount(ChildMask(chunkFirst + before)));
+			}
+		}
+		return next;
+	}
+};
+
+inline uint8_t HierarchyViewNode::nodeType() const
+{
+	return view->Type(record_index);
+}
+
+inline uint8_t HierarchyViewNode::childMask() const
+{
+	return view->ChildMask(record_index);
+}
+
+// 0 for nodes without data, like OctreeGeometryNode
+inline uint32_t HierarchyViewNode::numPoints() const
+{
+	return byteSize() == 0 ? 0 : view->NumPoints(record_index);
+}
+
+inline uint64_t HierarchyViewNode::byteOffset() const
+{
+	return view->ByteOffset(record_index);
+}
+
+inline uint64_t HierarchyViewNode::byteSize() const
+{
+	return view->ByteSize(record_index);
+}
+
+inline double HierarchyViewNode::spacing() const
+{
+	return view->root_spacing * InversePowerOfTwo(level());
+}
+
+inline geometry::BoundingBox HierarchyViewNode::boundingBox() const
+{
+	return NodeBoundingBox(view->root_box, node_key);
+}
+
+inline HierarchyViewNode HierarchyViewNode::child(int n) const
+{
+	const uint8_t mask = childMask();
+	int octant = 0;
+	for (int skipped = 0; octant < 8; ++octant)
+	{
+		if (((mask >> octant) & 1) && skipped++ == n) {
+			break;
+		}
+	}
+	if (n < 0 || octant == 8) {
+		return HierarchyViewNode();
+	}
+
+	const uint64_t local = view->ChildStart(chunk_first, record_index - chunk_first) + static_cast<uint64_t>(n);
+	return view->MakeNode(chunk_first, chunk_records, local, node_key.child(octant));
+}
+
+inline HierarchyViewNode HierarchyViewNode::childAt(int octant) const
+{
+	const uint8_t mask = childMask();
+	if (octant < 0 || octant > 7 || ((mask >> octant) & 1) == 0) {
+		return HierarchyViewNode();
+	}
+
+	// Children before this octant
+	return child(std::popcount(static_cast<uint8_t>(mask & ((1u << octant) - 1))));
+}
+
+#endif
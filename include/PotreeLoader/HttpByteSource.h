@@ -0,0 +1,590 @@
+#pragma once
+#ifndef HTTPBYTESOURCE_H
+#define HTTPBYTESOURCE_H
+#include <vector>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <exception>
+#include <stdexcept>
+#include <unordered_map>
+#include <cstdint>
+#include <cstring>
+#include <cctype>
+#include <cerrno>
+#include <algorithm>
+#include "ByteSource.h"
+
+#ifdef _WIN32
+	#include <winsock2.h>
+	#include <ws2tcpip.h>
+	#pragma comment(lib, "Ws2_32.lib")
+#else
+	#include <sys/types.h>
+	#include <sys/socket.h>
+	#include <sys/time.h>
+	#include <netdb.h>
+	#include <netinet/in.h>
+	#include <netinet/tcp.h>
+	#include <unistd.h>
+#endif
+
+struct HttpUrl
+{
+	std::string host;
+	std::string port;
+	std::string path;
+
+	// Only plain http is supported, e.g. http://host:8080/datasets/a/octree.bin
+	static HttpUrl Parse(const std::string& url)
+	{
+		const std::string scheme = "http://";
+		if (url.compare(0, scheme.size(), scheme) != 0) {
+			throw std::invalid_argument("Only http:// URLs are supported: " + url);
+		}
+
+		HttpUrl parsed;
+		const size_t hostStart = scheme.size();
+		const size_t pathStart = url.find('/', hostStart);
+		const std::string authority = url.substr(hostStart, pathStart == std::string::npos ? std::string::npos : pathStart - hostStart);
+		parsed.path = pathStart == std::string::npos ? "/" : url.substr(pathStart);
+
+		parsed.port = "80";
+		if (!authority.empty() && authority[0] == '[') {
+			// IPv6 literal like [::1]:8080, the port can only follow the closing bracket
+			const size_t close = authority.find(']');
+			if (close == std::string::npos || (close + 1 < authority.size() && authority[close + 1] != ':')) {
+				throw std::invalid_argument("Malformed IPv6 host in URL: " + url);
+			}
+			parsed.host = authority.substr(1, close - 1);
+			if (close + 2 < authority.size()) {
+				parsed.port = authority.substr(close + 2);
+			}
+		}
+		else {
+			const size_t colon = authority.rfind(':');
+			if (colon != std::string::npos) {
+				parsed.host = authority.substr(0, colon);
+				parsed.port = authority.substr(colon + 1);
+			}
+			else {
+				parsed.host = authority;
+			}
+		}
+
+		if (parsed.host.empty()) {
+			throw std::invalid_argument("URL without host: " + url);
+		}
+
+		return parsed;
+	}
+};
+
+// Thrown when a connection broke, as opposed to errors reported by the server. Requests on reused connections are retried once
+struct HttpConnectionError : std::runtime_error
+{
+	using std::runtime_error::runtime_error;
+};
+
+// One keep-alive HTTP/1.1 connection
+class HttpConnection
+{
+public:
+#ifdef _WIN32
+	using SocketHandle = SOCKET;
+	static constexpr SocketHandle InvalidSocket = INVALID_SOCKET;
+#else
+	using SocketHandle = int;
+	static constexpr SocketHandle InvalidSocket = -1;
+#endif
+
+	struct ResponseHead
+	{
+		int status = 0;
+		bool http10 = false; // HTTP/1.0 response, whose connections close unless the server asks to keep them alive
+		std::unordered_map<std::string, std::string> headers; // Names are lower case
+
+		std::string Header(const std::string& name) const
+		{
+			auto it = headers.find(name);
+			return it == headers.end() ? std::string() : it->second;
+		}
+	};
+
+private:
+	SocketHandle sock = InvalidSocket;
+	std::vector<char> received; // Bytes received beyond what was consumed so far
+	size_t received_pos = 0;
+
+	static void InitSockets()
+	{
+#ifdef _WIN32
+		static struct WinsockInit {
+			WinsockInit() { WSADATA data; WSAStartup(MAKEWORD(2, 2), &data); }
+			~WinsockInit() { WSACleanup(); }
+		} init;
+#endif
+	}
+
+	static void CloseSocket(SocketHandle handle)
+	{
+#ifdef _WIN32
+		closesocket(handle);
+#else
+		::close(handle);
+#endif
+	}
+
+	// Receives more bytes into 'received'. Throws if the peer closed the connection
+	void Receive()
+	{
+		if (received_pos == received.size()) {
+			received.clear();
+			received_pos = 0;
+		}
+
+		char chunk[64 * 1024];
+		while (true)
+		{
+			const auto count = ::recv(sock, chunk, static_cast<int>(sizeof(chunk)), 0);
+			if (count > 0) {
+				received.insert(received.end(), chunk, chunk + count);
+				return;
+			}
+#ifndef _WIN32
+			if (count < 0 && errno == EINTR) {
+				continue;
+			}
+#endif
+			throw HttpConnectionError("Connection closed by server");
+		}
+	}
+
+public:
+	HttpConnection(const HttpUrl& url, int timeoutSeconds)
+	{
+		InitSockets();
+
+		addrinfo hints;
+		memset(&hints, 0, sizeof(hints));
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_STREAM;
+
+		addrinfo* addresses = nullptr;
+		if (::getaddrinfo(url.host.c_str(), url.port.c_str(), &hints, &addresses) != 0) {
+			throw std::runtime_error("Could not resolve host: " + url.host);
+		}
+
+		for (addrinfo* address = addresses; address != nullptr; address = address->ai_next)
+		{
+			sock = ::socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+			if (sock == InvalidSocket) {
+				continue;
+			}
+			if (::connect(sock, address->ai_addr, static_cast<int>(address->ai_addrlen)) == 0) {
+				break;
+			}
+			CloseSocket(sock);
+			sock = InvalidSocket;
+		}
+		::freeaddrinfo(addresses);
+
+		if (sock == InvalidSocket) {
+			throw HttpConnectionError("Could not connect to " + url.host + ":" + url.port);
+		}
+
+		int noDelay = 1;
+		::setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+
+#ifdef _WIN32
+		DWORD timeout = static_cast<DWORD>(timeoutSeconds) * 1000;
+#else
+		timeval timeout;
+		timeout.tv_sec = timeoutSeconds;
+		timeout.tv_usec = 0;
+#endif
+		::setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+		::setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+	}
+
+	HttpConnection(const HttpConnection&) = delete;
+	HttpConnection& operator=(const HttpConnection&) = delete;
+
+	~HttpConnection()
+	{
+		if (sock != InvalidSocket) {
+			CloseSocket(sock);
+		}
+	}
+
+	void Send(const std::string& request)
+	{
+		size_t sent = 0;
+		while (sent < request.size())
+		{
+#ifdef MSG_NOSIGNAL
+			const auto count = ::send(sock, request.data() + sent, static_cast<int>(request.size() - sent), MSG_NOSIGNAL);
+#else
+			const auto count = ::send(sock, request.data() + sent, static_cast<int>(request.size() - sent), 0);
+#endif
+			if (count <= 0) {
+				throw HttpConnectionError("Could not send request");
+			}
+			sent += static_cast<size_t>(count);
+		}
+	}
+
+	ResponseHead ReadHead()
+	{
+		// Receive until the end of the header block
+		const char* terminator = "\r\n\r\n";
+		size_t headEnd;
+		while (true)
+		{
+			auto begin = received.begin() + received_pos;
+			auto found = std::search(begin, received.end(), terminator, terminator + 4);
+			if (found != received.end()) {
+				headEnd = static_cast<size_t>(found - received.begin());
+				break;
+			}
+			Receive();
+		}
+
+		std::string head(received.begin() + received_pos, received.begin() + headEnd);
+		received_pos = headEnd + 4;
+
+		ResponseHead response;
+		size_t lineStart = 0;
+		bool statusLine = true;
+
+		while (lineStart <= head.size())
+		{
+			size_t lineEnd = head.find("\r\n", lineStart);
+			if (lineEnd == std::string::npos) {
+				lineEnd = head.size();
+			}
+			std::string line = head.substr(lineStart, lineEnd - lineStart);
+			lineStart = lineEnd + 2;
+
+			if (statusLine) {
+				// HTTP/1.1 206 Partial Content
+				const size_t space = line.find(' ');
+				if (line.compare(0, 5, "HTTP/") != 0 || space == std::string::npos) {
+					throw HttpConnectionError("Malformed HTTP response");
+				}
+				response.status = std::atoi(line.c_str() + space + 1);
+				response.http10 = line.compare(0, space, "HTTP/1.0") == 0;
+				statusLine = false;
+				continue;
+			}
+
+			const size_t colon = line.find(':');
+			if (colon == std::string::npos) {
+				continue;
+			}
+
+			std::string name = line.substr(0, colon);
+			std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+			size_t valueStart = line.find_first_not_of(" \t", colon + 1);
+			response.headers[name] = valueStart == std::string::npos ? std::string() : line.substr(valueStart);
+		}
+
+		return response;
+	}
+
+	// Copies the next 'count' body bytes to target, or drops them if target is nullptr
+	void ReadBody(uint8_t* target, uint64_t count)
+	{
+		while (count > 0)
+		{
+			if (received_pos == received.size()) {
+				Receive();
+			}
+
+			const size_t available = (std::min)(static_cast<uint64_t>(received.size() - received_pos), count);
+			if (target != nullptr) {
+				memcpy(target, received.data() + received_pos, available);
+				target += available;
+			}
+			received_pos += available;
+			count -= available;
+		}
+	}
+};
+
+struct HttpSourceOptions
+{
+	unsigned maxConnections = 8; // Upper limit of parallel range requests
+	int timeoutSeconds = 30;
+};
+
+// Reads a file from an HTTP server with range requests. Connections are kept alive and reused,
+// batches of ranges are requested in parallel over several connections
+class HttpByteSource : public ByteSource
+{
+	std::string url_string;
+	HttpUrl url;
+	HttpSourceOptions options;
+	uint64_t content_size = 0;
+
+	mutable std::mutex pool_mutex;
+	mutable std::vector<std::unique_ptr<HttpConnection>> idle_connections;
+
+	std::unique_ptr<HttpConnection> Acquire(bool& reused) const
+	{
+		{
+			std::lock_guard<std::mutex> lock(pool_mutex);
+			if (!idle_connections.empty()) {
+				auto connection = std::move(idle_connections.back());
+				idle_connections.pop_back();
+				reused = true;
+				return connection;
+			}
+		}
+
+		reused = false;
+		return std::make_unique<HttpConnection>(url, options.timeoutSeconds);
+	}
+
+	void Release(std::unique_ptr<HttpConnection> connection) const
+	{
+		std::lock_guard<std::mutex> lock(pool_mutex);
+		if (idle_connections.size() < options.maxConnections) {
+			idle_connections.push_back(std::move(connection));
+		}
+	}
+
+	std::string RequestHead(const char* method) const
+	{
+		// IPv6 literals keep their brackets in the Host header
+		const std::string host = url.host.find(':') == std::string::npos ? url.host : "[" + url.host + "]";
+		return std::string(method) + " " + url.path + " HTTP/1.1\r\nHost: " + host + "\r\nConnection: keep-alive\r\n";
+	}
+
+	// HTTP/1.1 connections persist unless the server sends "Connection: close", HTTP/1.0 connections only with "Connection: keep-alive"
+	static bool KeepsAlive(const HttpConnection::ResponseHead& head)
+	{
+		std::string connection = head.Header("connection");
+		std::transform(connection.begin(), connection.end(), connection.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+		bool close = false;
+		bool keepAlive = false;
+		size_t tokenStart = 0;
+		while (tokenStart < connection.size())
+		{
+			size_t tokenEnd = connection.find(',', tokenStart);
+			if (tokenEnd == std::string::npos) {
+				tokenEnd = connection.size();
+			}
+			const size_t first = connection.find_first_not_of(" \t", tokenStart);
+			const size_t last = connection.find_last_not_of(" \t", tokenEnd - 1);
+			if (first != std::string::npos && first < tokenEnd && last >= first)
+			{
+				const std::string token = connection.substr(first, last - first + 1);
+				close = close || token == "close";
+				keepAlive = keepAlive || token == "keep-alive";
+			}
+			tokenStart = tokenEnd + 1;
+		}
+
+		return !close && (keepAlive || !head.http10);
+	}
+
+	// Content-Range of a single range response, e.g. "bytes 100-199/1000". Throws unless it is exactly the requested range,
+	// so multipart/byteranges responses and ranges the server shifted or clamped are never taken for the requested bytes
+	void CheckContentRange(const HttpConnection::ResponseHead& head, uint64_t byte_start, uint64_t byte_size, uint64_t length) const
+	{
+		const std::string range = head.Header("content-range");
+		const std::string unit = "bytes ";
+		const size_t dash = range.find('-');
+		const size_t slash = range.find('/');
+
+		bool matches = false;
+		if (range.compare(0, unit.size(), unit) == 0 && dash != std::string::npos && slash != std::string::npos && dash < slash)
+		{
+			const std::string first = range.substr(unit.size(), dash - unit.size());
+			const std::string last = range.substr(dash + 1, slash - dash - 1);
+			const auto isNumber = [](const std::string& text) {
+				return !text.empty() && std::all_of(text.begin(), text.end(), [](unsigned char c) { return std::isdigit(c) != 0; });
+			};
+
+			matches = isNumber(first) && isNumber(last)
+				&& std::stoull(first) == byte_start
+				&& std::stoull(last) == byte_start + byte_size - 1
+				&& length == byte_size;
+		}
+
+		if (!matches) {
+			throw std::runtime_error("HTTP range response with Content-Range '" + range + "' for requested bytes " + std::to_string(byte_start) + "-" + std::to_string(byte_start + byte_size - 1) + " of " + url_string);
+		}
+	}
+
+	static uint64_t ContentLength(const HttpConnection::ResponseHead& head)
+	{
+		if (!head.Header("transfer-encoding").empty()) {
+			throw std::runtime_error("Chunked HTTP responses are not supported");
+		}
+
+		const std::string length = head.Header("content-length");
+		if (length.empty()) {
+			throw std::runtime_error("HTTP response without Content-Length");
+		}
+
+		return std::stoull(length);
+	}
+
+	// Runs one request on a pooled connection. A request on a reused connection which turned out
+	// to be closed by the server in the meantime is repeated once on a new connection
+	template<class Exchange>
+	auto Request(Exchange exchange) const
+	{
+		for (int attempt = 0; ; ++attempt)
+		{
+			bool reused = false;
+			auto connection = Acquire(reused);
+			bool keepAlive = false;
+
+			try {
+				auto result = exchange(*connection, keepAlive);
+				if (keepAlive) {
+					Release(std::move(connection));
+				}
+				return result;
+			}
+			catch (const HttpConnectionError&) {
+				if (!reused || attempt > 0) {
+					throw;
+				}
+			}
+		}
+	}
+
+public:
+	HttpByteSource(const std::string& urlString, const HttpSourceOptions& options = HttpSourceOptions())
+		: url_string(urlString), url(HttpUrl::Parse(urlString)), options(options)
+	{
+		content_size = Request([this](HttpConnection& connection, bool& keepAlive) {
+			connection.Send(RequestHead("HEAD") + "\r\n");
+			auto head = connection.ReadHead();
+
+			if (head.status != 200) {
+				throw std::runtime_error("HTTP status " + std::to_string(head.status) + " for " + url_string);
+			}
+
+			keepAlive = KeepsAlive(head);
+			return ContentLength(head);
+			});
+	}
+
+	std::string Name() const override
+	{
+		return url_string;
+	}
+
+	uint64_t Size() const override
+	{
+		return content_size;
+	}
+
+	size_t ReadAt(uint64_t byte_start, uint64_t byte_size, uint8_t* target) const override
+	{
+		if (byte_start >= content_size || byte_size == 0) {
+			return 0;
+		}
+
+		byte_size = (std::min)(byte_start + byte_size, content_size) - byte_start;
+
+		return Request([&](HttpConnection& connection, bool& keepAlive) -> size_t {
+			connection.Send(RequestHead("GET") + "Range: bytes=" + std::to_string(byte_start) + "-" + std::to_string(byte_start + byte_size - 1) + "\r\n\r\n");
+			auto head = connection.ReadHead();
+			const uint64_t length = ContentLength(head);
+
+			if (head.status == 206) {
+				CheckContentRange(head, byte_start, byte_size, length);
+				connection.ReadBody(target, byte_size);
+				keepAlive = KeepsAlive(head);
+				return static_cast<size_t>(byte_size);
+			}
+
+			if (head.status == 200) {
+				// Server ignored the range and sends the whole file
+				const uint64_t skipped = (std::min)(byte_start, length);
+				const uint64_t used = (std::min)(byte_size, length - skipped);
+				connection.ReadBody(nullptr, skipped);
+				connection.ReadBody(target, used);
+				connection.ReadBody(nullptr, length - skipped - used);
+				keepAlive = KeepsAlive(head);
+				return static_cast<size_t>(used);
+			}
+
+			if (head.status == 416) {
+				connection.ReadBody(nullptr, length);
+				keepAlive = KeepsAlive(head);
+				return size_t(0);
+			}
+
+			throw std::runtime_error("HTTP status " + std::to_string(head.status) + " for " + url_string);
+			});
+	}
+
+	// Requests the ranges in parallel, using up to min(queueDepth, maxConnections) connections
+	void Read(const std::vector<AsyncReadRequest>& requests, const AsyncReadCallback& callback, const AsyncReadOptions& readOptions = AsyncReadOptions()) const override
+	{
+		const size_t workerCount = (std::min)({ static_cast<size_t>((std::max)(readOptions.queueDepth, 1u)), static_cast<size_t>((std::max)(options.maxConnections, 1u)), requests.size() });
+
+		std::atomic<size_t> nextRequest{ 0 };
+		std::atomic<bool> failed{ false };
+		std::exception_ptr error;
+		std::mutex callbackMutex;
+
+		auto worker = [&]() {
+			std::vector<uint8_t> buffer;
+
+			while (!failed)
+			{
+				const size_t index = nextRequest++;
+				if (index >= requests.size()) {
+					return;
+				}
+
+				const auto& request = requests[index];
+				if (buffer.size() < request.byteSize) {
+					buffer.resize(static_cast<size_t>(request.byteSize));
+				}
+
+				try {
+					const size_t bytes_read = ReadAt(request.byteOffset, request.byteSize, buffer.data());
+
+					std::lock_guard<std::mutex> lock(callbackMutex);
+					if (!failed) {
+						callback(request.id, buffer.data(), bytes_read);
+					}
+				}
+				catch (...) {
+					std::lock_guard<std::mutex> lock(callbackMutex);
+					if (!failed) {
+						error = std::current_exception();
+						failed = true;
+					}
+				}
+			}
+		};
+
+		std::vector<std::thread> workers;
+		workers.reserve(workerCount);
+		for (size_t i = 0; i < workerCount; ++i) {
+			workers.emplace_back(worker);
+		}
+		for (auto& thread : workers) {
+			thread.join();
+		}
+
+		if (error) {
+			std::rethrow_exception(error);
+		}
+	}
+};
+
+#endif
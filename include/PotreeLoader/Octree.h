@@ -2,17 +2,34 @@
 #ifndef OCTREE_H
 #define OCTREE_H
 
-#include "..\OctreeCore.h"
-#include "..\ThirdParty/PotreeConverter/Attributes.h"
-#include "..\ThirdParty/PotreeConverter/Geometry.h"
-#include "..\ThirdParty/PotreeConverter/Buffer.h"
-#include "..\ThirdParty/json/json.hpp"
+#include "../OctreeCore.h"
+#include "../ThirdParty/PotreeConverter/Attributes.h"
+#include "../ThirdParty/PotreeConverter/Geometry.h"
+#include "../ThirdParty/PotreeConverter/Buffer.h"
+#include "../ThirdParty/json/json.hpp"
+#include "ByteSource.h"
+#include "PackedOctreeFile.h"
+#include "OctreeArchive.h"
+#include "OctreeNodeKey.h"
+#include "OctreeNodeBounds.h"
+#include "OctreeNodeTable.h"
+#include "OctreeNodeIndex.h"
+#include "OctreeTraversal.h"
+#include "OctreeRegionQuery.h"
+#include "OctreeLodSelection.h"
+#include "OctreeDensitySelection.h"
+#include "HierarchySnapshot.h"
 
 #include <map>
 #include <any>
 #include <stdexcept>
 #include <unordered_map>
 #include <regex>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <concepts>
 
 using std::vector;
 using std::string;
@@ -23,6 +40,12 @@ using json = nlohmann::json;
 using BoundingBox = geometry::BoundingBox;
 using Vector3 = geometry::Vector3;
 
+// Define POTREELOADER_IMPLICIT_BOUNDING_BOXES as 1 to drop OctreeGeometryNode::boundingBox (48 bytes per node).
+// Node boxes are then computed from the root box and the node key by OctreeGeometryNode::bounds
+#ifndef POTREELOADER_IMPLICIT_BOUNDING_BOXES
+	#define POTREELOADER_IMPLICIT_BOUNDING_BOXES 0
+#endif
+
 enum NODETYPE {
 	NORMAL = 0,
 	LEAF = 1,
@@ -30,6 +53,16 @@ enum NODETYPE {
 };
 
 struct OctreeGeometryNode;
+class LazyHierarchy;
+
+// Eager loads all hierarchy chunks up front. Lazy loads only the first chunk and every further chunk
+// when a traversal first reaches its proxy node, see OctreeGeometryNode::expand.
+// Table builds only the compact geometry.nodeTable, without OctreeGeometryNode objects (geometry.root stays empty)
+enum class HierarchyLoading {
+	Eager = 0,
+	Lazy = 1,
+	Table = 2,
+};
 
 struct Hierarchy
 {
@@ -43,6 +76,16 @@ struct OctreeFiles
 	string hierarchy;
 	string octree;
 	string metadata;
+
+	// Set when the octree data is embedded in a larger file, e.g. a packed octree file. Otherwise octree.bin is read as a whole.
+	// Only octreeEmbedded tells the cases apart, an embedded octree section may be empty and start at any offset
+	bool octreeEmbedded = false;
+	uint64_t octreeOffset = 0;
+	uint64_t octreeSize = 0;
+
+	// Same for the hierarchy, see HierarchyView
+	uint64_t hierarchyOffset = 0;
+	uint64_t hierarchySize = 0;
 };
 
 class OctreeGeometry
@@ -59,13 +102,18 @@ public:
 	std::shared_ptr<OctreeGeometryNode> root;
 	std::vector<shared_ptr<OctreeGeometryNode>> nodes;
 	int64_t traversableNodes;
+	std::shared_ptr<LazyHierarchy> lazyHierarchy; // Only set with HierarchyLoading::Lazy
+	std::shared_ptr<OctreeNodeTable> nodeTable;   // Only set with HierarchyLoading::Table
+	std::shared_ptr<OctreeNodeIndex<OctreeGeometryNode*>> nodeIndex; // Node objects by key, see Octree::FindNode
 };
 
 struct OctreeGeometryNode
 {
-	string name;
+	OctreeNodeKey key;
 	int64_t index;
+#if !POTREELOADER_IMPLICIT_BOUNDING_BOXES
 	BoundingBox boundingBox;
+#endif
 	int64_t numPoints;
 	int64_t level;
 	
@@ -78,12 +126,22 @@ struct OctreeGeometryNode
 	double spacing;
 	NODETYPE nodeType;
 
-	OctreeGeometryNode() : OctreeGeometryNode("", nullptr, BoundingBox()) {};
+	// True for proxy nodes of a lazily loaded hierarchy whose chunk was not read yet. Their byteOffset and byteSize
+	// point into the hierarchy file and they have no children until expand() is called
+	std::atomic<bool> pendingChunk{ false };
+
+	OctreeGeometryNode() : OctreeGeometryNode(OctreeNodeKey::Root(), nullptr, BoundingBox()) {};
 
-	OctreeGeometryNode(const string& name, OctreeGeometry* octreeGeometry, const BoundingBox& boundingBox)
-		: name(name), octreeGeometry(octreeGeometry), boundingBox(boundingBox)
+	// The bounding box is ignored with POTREELOADER_IMPLICIT_BOUNDING_BOXES
+	OctreeGeometryNode(const OctreeNodeKey& key, OctreeGeometry* octreeGeometry, const BoundingBox& boundingBox = BoundingBox())
+		: key(key), octreeGeometry(octreeGeometry)
 	{
-		index = name.empty() ? -1 : name.at(name.size() - 1) - '0';
+#if !POTREELOADER_IMPLICIT_BOUNDING_BOXES
+		this->boundingBox = boundingBox;
+#else
+		(void)boundingBox;
+#endif
+		index = key.octant();
 		numPoints = 0;
 		level = 0;
 		parent = nullptr;
@@ -95,7 +153,23 @@ struct OctreeGeometryNode
 
 	bool operator==(const OctreeGeometryNode& rhs) const
 	{
-		return this->name == rhs.name;
+		return this->key == rhs.key;
+	}
+
+	// Node name like "r0426", built from the key
+	string name() const
+	{
+		return key.name();
+	}
+
+	// Bounding box of the node, either the stored one or computed from the key with POTREELOADER_IMPLICIT_BOUNDING_BOXES
+	BoundingBox bounds() const
+	{
+#if POTREELOADER_IMPLICIT_BOUNDING_BOXES
+		return octreeGeometry ? NodeBoundingBox(octreeGeometry->boundingBox, key) : BoundingBox();
+#else
+		return boundingBox;
+#endif
 	}
 
 	bool hasChildren() const
@@ -103,56 +177,81 @@ struct OctreeGeometryNode
 		return !children.empty();
 	}
 
-	void traverse(std::function<void(OctreeGeometryNode*, int)> callback, int level = 0) {
+	// Loads the hierarchy chunk of a pending proxy node, which fills in the node and creates its children.
+	// Does nothing for other nodes. Thread-safe, each chunk is read once. Traversals call this for every node they reach
+	void expand();
 
-		callback(this, level);
+	// Depth-first pre-order over the subtree, see TraverseDepthFirst. level is passed for this node and counts up from there
+	template<typename Callback> requires std::invocable<Callback&, OctreeGeometryNode*, int>
+	void traverse(Callback&& callback, int level = 0) {
 
-		for (auto& child : children) {
-			if (child != nullptr) {
-				child->traverse(callback, level + 1);
-			}
-		}
+		const int start = static_cast<int>(this->level);
+		TraverseDepthFirst(this, [&callback, start, level](OctreeGeometryNode* node, int nodeLevel) {
+			callback(node, nodeLevel - start + level);
+		});
 	}
 
-	void traverse(std::function<void(OctreeGeometryNode*)> callback) {
+	template<typename Callback> requires (std::invocable<Callback&, OctreeGeometryNode*> && !std::invocable<Callback&, OctreeGeometryNode*, int>)
+	void traverse(Callback&& callback) {
 
-		callback(this);
-
-		for (auto& child : children) {
-			if (child != nullptr) {
-				child->traverse(callback);
-			}
-		}
+		TraverseDepthFirst(this, [&callback](OctreeGeometryNode* node) {
+			callback(node);
+		});
 	}
 
-	void traverse_conditional(std::function<void(OctreeGeometryNode*, int)> callback, std::function<bool(OctreeGeometryNode*, int level)> condition, int level = 0) {
+	// Depth-first pre-order over the nodes whose own level lies within levels. Deeper subtrees are not entered,
+	// so with HierarchyLoading::Lazy their chunks are not loaded. Passes node->level instead of a counted level
+	template<typename Callback> requires std::invocable<Callback&, OctreeGeometryNode*, int>
+	void traverse(Callback&& callback, const LevelRange& levels) {
 
-		if (!condition(this, level)){
-			return;
-		}
+		TraverseDepthFirst(this, [&callback](OctreeGeometryNode* node, int nodeLevel) {
+			callback(node, nodeLevel);
+		}, levels);
+	}
 
-		callback(this, level);
+	// Depth-first pre-order. The whole subtree of a node which fails the condition is skipped
+	template<typename Callback, typename Condition> requires std::invocable<Callback&, OctreeGeometryNode*, int>
+	void traverse_conditional(Callback&& callback, Condition&& condition, int level = 0) {
 
-		for (auto& child : children) {
-			if (child != nullptr) {
-				child->traverse(callback, level + 1);
+		const int start = static_cast<int>(this->level);
+		TraverseDepthFirst(this, [&callback, &condition, start, level](OctreeGeometryNode* node, int nodeLevel) {
+			const int countedLevel = nodeLevel - start + level;
+			if (!condition(node, countedLevel)) {
+				return TraversalAction::SkipChildren;
 			}
-		}
+
+			callback(node, countedLevel);
+			return TraversalAction::Continue;
+		});
 	}
 
-	void traverse_conditional(std::function<void(OctreeGeometryNode*)> callback, std::function<bool(OctreeGeometryNode*)> condition) {
+	template<typename Callback, typename Condition> requires (std::invocable<Callback&, OctreeGeometryNode*> && !std::invocable<Callback&, OctreeGeometryNode*, int>)
+	void traverse_conditional(Callback&& callback, Condition&& condition) {
 
-		if (!condition(this)){
-			return;
-		}
+		TraverseDepthFirst(this, [&callback, &condition](OctreeGeometryNode* node) {
+			if (!condition(node)) {
+				return TraversalAction::SkipChildren;
+			}
 
-		callback(this);
+			callback(node);
+			return TraversalAction::Continue;
+		});
+	}
 
-		for (auto& child : children) {
-			if (child != nullptr) {
-				child->traverse(callback);
+	// Conditional traversal within a level range, see above. The condition also prunes above levels.minLevel
+	template<typename Callback, typename Condition> requires std::invocable<Callback&, OctreeGeometryNode*, int>
+	void traverse_conditional(Callback&& callback, Condition&& condition, const LevelRange& levels) {
+
+		TraverseDepthFirst(this, [&callback, &condition, &levels](OctreeGeometryNode* node, int nodeLevel) {
+			if (!condition(node, nodeLevel)) {
+				return TraversalAction::SkipChildren;
 			}
-		}
+
+			if (levels.contains(nodeLevel)) {
+				callback(node, nodeLevel);
+			}
+			return TraversalAction::Continue;
+		}, LevelRange::UpTo(levels.maxLevel));
 	}
 };
 
@@ -250,11 +349,12 @@ vector<shared_ptr<OctreeGeometryNode>> CreateHierarchyNodes(shared_ptr<OctreeGeo
 				continue;
 			}
 
-			auto childName = current->name + to_string(childIndex);
-
+#if POTREELOADER_IMPLICIT_BOUNDING_BOXES
+			auto child = make_shared< OctreeGeometryNode>(current->key.child(childIndex), octree);
+#else
 			auto childAABB = createChildAABB(current->boundingBox, childIndex);
-			auto child = make_shared< OctreeGeometryNode>(childName, octree, childAABB);
-			child->name = childName;
+			auto child = make_shared< OctreeGeometryNode>(current->key.child(childIndex), octree, childAABB);
+#endif
 			child->spacing = current->spacing / 2;
 			child->level = current->level + 1;
 			child->parent = current.get();
@@ -271,6 +371,88 @@ vector<shared_ptr<OctreeGeometryNode>> CreateHierarchyNodes(shared_ptr<OctreeGeo
 	return nodes;
 }
 
+// Hierarchy chunks which are read when a traversal first reaches their proxy node, see HierarchyLoading::Lazy
+class LazyHierarchy
+{
+	std::shared_ptr<ByteSource> source;
+	std::mutex chunks_mutex;
+	std::vector<vector<shared_ptr<OctreeGeometryNode>>> chunks; // Owns the nodes of the chunks loaded so far
+	std::mutex expand_mutexes[64];                             // Chunks of different proxies can be loaded in parallel
+	std::shared_mutex index_mutex;                             // Guards the geometry's nodeIndex, which grows with every chunk
+
+public:
+	LazyHierarchy(std::shared_ptr<ByteSource> hierarchySource) : source(std::move(hierarchySource)) {}
+
+	void Expand(OctreeGeometryNode* proxy)
+	{
+		std::lock_guard<std::mutex> lock(expand_mutexes[std::hash<const void*>()(proxy) % 64]);
+
+		if (!proxy->pendingChunk.load(std::memory_order_relaxed)) {
+			return;
+		}
+
+		Buffer buffer(proxy->byteSize);
+		buffer.size = static_cast<int64_t>(source->ReadAt(proxy->byteOffset, proxy->byteSize, buffer.data_u8));
+
+		// CreateHierarchyNodes expects the chunk at byteOffset within the buffer, which only holds this chunk.
+		// The proxy is owned by its parent's chunk, so it is passed without ownership
+		const int64_t hierarchyOffset = proxy->byteOffset;
+		shared_ptr<OctreeGeometryNode> node(shared_ptr<OctreeGeometryNode>(), proxy);
+		vector<shared_ptr<OctreeGeometryNode>> nodes;
+
+		proxy->byteOffset = 0;
+		try {
+			nodes = CreateHierarchyNodes(node, &buffer);
+		}
+		catch (...) {
+			proxy->byteOffset = hierarchyOffset;
+			throw;
+		}
+
+		for (size_t i = 1; i < nodes.size(); ++i)
+		{
+			if (nodes[i]->nodeType == NODETYPE::PROXY) {
+				nodes[i]->pendingChunk.store(true, std::memory_order_relaxed);
+			}
+		}
+
+		if (auto& index = proxy->octreeGeometry->nodeIndex)
+		{
+			std::unique_lock<std::shared_mutex> indexLock(index_mutex);
+			for (size_t i = 1; i < nodes.size(); ++i) {
+				index->Insert(nodes[i]->key, nodes[i].get());
+			}
+		}
+
+		{
+			std::lock_guard<std::mutex> chunksLock(chunks_mutex);
+			chunks.push_back(std::move(nodes));
+		}
+
+		// Publishes the node's new content and children to threads which check pendingChunk
+		proxy->pendingChunk.store(false, std::memory_order_release);
+	}
+
+	// Held shared while reading the node index
+	std::shared_mutex& IndexMutex()
+	{
+		return index_mutex;
+	}
+
+	size_t LoadedChunks()
+	{
+		std::lock_guard<std::mutex> chunksLock(chunks_mutex);
+		return chunks.size();
+	}
+};
+
+inline void OctreeGeometryNode::expand()
+{
+	if (pendingChunk.load(std::memory_order_acquire)) {
+		octreeGeometry->lazyHierarchy->Expand(this);
+	}
+}
+
 
 json loadMetadataJson(const string& filepath)
 {
@@ -336,6 +518,30 @@ Hierarchy parseMetadataHierarchy(json js)
 
 namespace octree_files
 {
+	// Returns "hierarchy", "octree" or "metadata" if the file name is one of the octree files, an empty string otherwise
+	string OctreeFileKind(const string& filename)
+	{
+		// regex pattern for search
+		static const std::regex hierarchy_pattern("hierarchy.*.bin");
+		static const std::regex octree_pattern("octree.*.bin");
+		static const std::regex metadata_pattern("metadata.*.json");
+
+		if (std::regex_match(filename, hierarchy_pattern))
+		{
+			return "hierarchy";
+		}
+		else if (std::regex_match(filename, octree_pattern))
+		{
+			return "octree";
+		}
+		else if (std::regex_match(filename, metadata_pattern))
+		{
+			return "metadata";
+		}
+
+		return "";
+	}
+
 	map<string, string> SearchOctreeFiles(const string& octreeFilepath)
 	{
 		fs::path searchFolder(octreeFilepath);
@@ -350,11 +556,6 @@ namespace octree_files
 			throw std::invalid_argument("Argument search path can not be resolved to a directory");
 		}
 
-		// regex pattern for search
-		const std::regex hierarchy_pattern("hierarchy.*.bin");
-		const std::regex octree_pattern("octree.*.bin");
-		const std::regex metadata_pattern("metadata.*.json");
-
 		std::map<string, string> octreeFiles =
 		{
 			{"hierarchy", ""},
@@ -368,25 +569,32 @@ namespace octree_files
 			if (entry.is_regular_file())
 			{
 				auto& filepath = entry.path();
-				string filename = filepath.filename().string();
+				string kind = OctreeFileKind(filepath.filename().string());
 
-				if (std::regex_match(filename, hierarchy_pattern))
-				{
-					octreeFiles["hierarchy"] = filepath.string();
-				}
-				else if (std::regex_match(filename, octree_pattern))
-				{
-					octreeFiles["octree"] = filepath.string();
-				}
-				else if (std::regex_match(filename, metadata_pattern))
+				if (!kind.empty())
 				{
-					octreeFiles["metadata"] = filepath.string();
+					octreeFiles[kind] = filepath.string();
 				}
 			}
 		}
 
 		return octreeFiles;
 	}
+
+	// Packs the dataset found at octreeFilepath (see SearchOctreeFiles) into a single packed octree file
+	PackedOctreeHeader PackOctree(const string& octreeFilepath, const string& packedFilepath)
+	{
+		auto octreeFiles = SearchOctreeFiles(octreeFilepath);
+
+		for (const auto& [kind, path] : octreeFiles)
+		{
+			if (path.empty()) {
+				throw std::invalid_argument("No " + kind + " file found for: " + octreeFilepath);
+			}
+		}
+
+		return PackOctreeFiles(octreeFiles["metadata"], octreeFiles["hierarchy"], octreeFiles["octree"], packedFilepath);
+	}
 }
 
 class Octree
@@ -401,6 +609,20 @@ public:
 	OctreeGeometry geometry;
 	Hierarchy hierarchy;
 
+	// Set when the octree was loaded from byte sources. OctreeLoader then reads node data from it instead of files.octree
+	std::shared_ptr<ByteSource> octreeSource;
+
+	// Applies to all Load functions. Set before loading or pass it to the constructor
+	HierarchyLoading hierarchyLoading = HierarchyLoading::Eager;
+
+	// Threads parsing hierarchy chunks with HierarchyLoading::Eager. 0 uses all hardware threads, 1 parses on the calling thread.
+	// The resulting nodes are the same either way
+	unsigned hierarchyThreads = 0;
+
+	// Builds geometry.nodeIndex (or the index of geometry.nodeTable) while loading, for constant time FindNode.
+	// Without it FindNode walks down from the root, which saves the index build when nodes are rarely looked up
+	bool buildNodeIndex = true;
+
 private:
 	void SearchOctreeFiles(const string& searchFolderPath)
 	{
@@ -411,14 +633,357 @@ private:
 		return;
 	}
 
+	// The files Load reads for datasetPath, without loading them
+	static OctreeFiles ResolveDatasetFiles(const string& datasetPath)
+	{
+		OctreeFiles resolved;
+		if (fs::path(datasetPath).extension() != ".json" && (PackedOctreeHeader::IsPackedFile(datasetPath) || ArchiveIndex::IsArchive(datasetPath)))
+		{
+			resolved.metadata  = datasetPath;
+			resolved.hierarchy = datasetPath;
+			resolved.octree    = datasetPath;
+			return resolved;
+		}
+
+		auto files_map     = octree_files::SearchOctreeFiles(datasetPath);
+		resolved.hierarchy = files_map["hierarchy"];
+		resolved.octree    = files_map["octree"];
+		resolved.metadata  = files_map["metadata"];
+		return resolved;
+	}
+
+	static bool IsSameFile(const string& lhs, const string& rhs)
+	{
+		std::error_code error;
+		const bool equivalent = fs::equivalent(lhs, rhs, error);
+		return error ? lhs == rhs : equivalent;
+	}
+
+	bool IsLoadedFrom(const OctreeFiles& dataset) const
+	{
+		return IsSameFile(files.metadata, dataset.metadata) && IsSameFile(files.hierarchy, dataset.hierarchy) && IsSameFile(files.octree, dataset.octree);
+	}
+
 public:
 	Octree() = default;
 
-	Octree(const string& metadataFilePath)
+	// Accepts the metadata file of a dataset, a packed octree file or an uncompressed zip or tar archive
+	Octree(const string& metadataFilePath, HierarchyLoading loading = HierarchyLoading::Eager) : hierarchyLoading(loading)
 	{
-		LoadFromMetadataFile(metadataFilePath);
+		Load(metadataFilePath);
 	};
 
+	// Loads the metadata file of a dataset, a packed octree file or an uncompressed zip or tar archive
+	void Load(const string& datasetPath)
+	{
+		files = OctreeFiles();
+		octreeSource.reset();
+
+		if (fs::path(datasetPath).extension() == ".json") {
+			LoadFromMetadataFile(datasetPath);
+		}
+		else if (PackedOctreeHeader::IsPackedFile(datasetPath)) {
+			LoadFromPackedFile(datasetPath);
+		}
+		else if (ArchiveIndex::IsArchive(datasetPath)) {
+			LoadFromArchive(datasetPath);
+		}
+		else {
+			LoadFromMetadataFile(datasetPath);
+		}
+	}
+
+	// Loads the octree from the snapshot if it was written for datasetPath and matches its files. Otherwise, e.g. when the
+	// snapshot does not exist, belongs to another dataset, is outdated or damaged, the dataset is loaded with Load and the
+	// snapshot is written for the next time
+	void LoadWithSnapshot(const string& datasetPath, const string& snapshotPath, SnapshotValidation validation = SnapshotValidation::SizeAndTime)
+	{
+		try
+		{
+			// A snapshot written for another dataset is valid on its own, so its sources have to be the dataset's files
+			if (LoadFromSnapshot(snapshotPath, validation) && IsLoadedFrom(ResolveDatasetFiles(datasetPath))) {
+				return;
+			}
+		}
+		catch (const std::exception&)
+		{
+			// Damaged or written by another version, replaced below
+		}
+
+		Load(datasetPath);
+
+		try {
+			SaveSnapshot(snapshotPath);
+		}
+		catch (const std::exception&)
+		{
+			// The snapshot is only a cache, e.g. a read-only snapshot folder just makes the next open slower
+			std::error_code error;
+			fs::remove(snapshotPath + ".tmp", error);
+		}
+	}
+
+	// Writes the parsed metadata and the complete hierarchy to a snapshot file, see HierarchySnapshot.h. LoadFromSnapshot
+	// restores the octree from it without parsing metadata.json or hierarchy.bin. The source files are stamped with size,
+	// modification time and, except for files holding octree data, a content hash. The snapshot is written to a temporary
+	// file which then replaces snapshotPath, so readers never see a partially written snapshot
+	void SaveSnapshot(const string& snapshotPath)
+	{
+		if (octreeSource) {
+			throw std::invalid_argument("Snapshots need local files, this octree was loaded from byte sources: " + geometry.url);
+		}
+
+		const OctreeNodeTable table = geometry.nodeTable ? *geometry.nodeTable : BuildTableFromNodes();
+
+		SnapshotWriter writer;
+		writer.PutString(files.metadata);
+		writer.PutString(files.hierarchy);
+		writer.PutString(files.octree);
+		writer.Put<uint8_t>(files.octreeEmbedded ? 1 : 0);
+		writer.Put<uint64_t>(files.octreeOffset);
+		writer.Put<uint64_t>(files.octreeSize);
+		writer.Put<uint64_t>(files.hierarchyOffset);
+		writer.Put<uint64_t>(files.hierarchySize);
+
+		vector<string> sources;
+		for (const auto* path : { &files.metadata, &files.hierarchy, &files.octree }) {
+			if (std::find(sources.begin(), sources.end(), *path) == sources.end()) {
+				sources.push_back(*path);
+			}
+		}
+
+		writer.Put<uint64_t>(sources.size());
+		for (const auto& path : sources)
+		{
+			const auto stamp = SnapshotSourceStamp::Of(path, path != files.octree);
+			writer.PutString(stamp.path);
+			writer.Put<uint64_t>(stamp.size);
+			writer.Put<int64_t>(stamp.modified);
+			writer.Put<uint64_t>(stamp.hash);
+		}
+
+		auto putVector = [&writer](const Vector3& value) {
+			writer.Put<double>(value.x);
+			writer.Put<double>(value.y);
+			writer.Put<double>(value.z);
+		};
+
+		writer.PutString(version);
+		writer.PutString(name);
+		writer.PutString(description);
+		writer.Put<int64_t>(points);
+
+		writer.PutString(geometry.url);
+		writer.PutString(geometry.projection);
+		writer.Put<double>(geometry.spacing);
+		for (const auto* box : { &geometry.boundingBox, &geometry.tightBoundingBox }) {
+			putVector(box->min);
+			putVector(box->max);
+		}
+		for (const auto* values : { &geometry.offset, &geometry.scale })
+		{
+			writer.Put<uint64_t>(values->size());
+			for (double value : *values) {
+				writer.Put<double>(value);
+			}
+		}
+
+		const auto& attributes = geometry.pointAttributes;
+		writer.Put<int32_t>(attributes.bytes);
+		putVector(attributes.posScale);
+		putVector(attributes.posOffset);
+		writer.Put<uint64_t>(attributes.list.size());
+		for (const auto& attribute : attributes.list)
+		{
+			writer.PutString(attribute.name);
+			writer.PutString(attribute.description);
+			writer.Put<int32_t>(attribute.size);
+			writer.Put<int32_t>(attribute.numElements);
+			writer.Put<int32_t>(attribute.elementSize);
+			writer.Put<int32_t>(static_cast<int32_t>(attribute.type));
+			putVector(attribute.min);
+			putVector(attribute.max);
+		}
+
+		writer.Put<int64_t>(hierarchy.firstChunkSize);
+		writer.Put<int64_t>(hierarchy.stepSize);
+		writer.Put<int64_t>(hierarchy.depth);
+
+		HierarchySnapshotHeader header;
+		header.metadataSize = writer.bytes.size();
+		header.nodeCount = table.size();
+
+		vector<size_t> elementSizes;
+		table.ForEachArray([&elementSizes](const auto& values) { elementSizes.push_back(sizeof(values[0])); });
+		const auto offsets = header.ArrayOffsets(elementSizes);
+
+		const string temporaryPath = snapshotPath + ".tmp";
+		{
+			OutputFile snapshot(temporaryPath);
+			snapshot.writeAt(header.metadataOffset, writer.bytes.data(), writer.bytes.size());
+
+			size_t array = 0;
+			table.ForEachArray([&](const auto& values) {
+				snapshot.writeAt(offsets[array++], reinterpret_cast<const uint8_t*>(values.data()), values.size() * sizeof(values[0]));
+			});
+
+			// The header goes last, so an interrupted write is not mistaken for a valid snapshot
+			uint8_t buffer[HierarchySnapshotHeader::headerSize];
+			header.Serialize(buffer);
+			snapshot.writeAt(0, buffer, sizeof(buffer));
+		}
+
+		fs::rename(temporaryPath, snapshotPath);
+	}
+
+	// Restores the octree from a snapshot written by SaveSnapshot. Returns false if the snapshot does not exist or
+	// its source files changed since it was written, throws and leaves the octree unchanged if the snapshot is damaged.
+	// The node arrays are copied straight from the mapped file. With HierarchyLoading::Table they become geometry.nodeTable,
+	// otherwise the node objects are created from them (Lazy behaves like Eager, the snapshot holds every chunk).
+	// geometry.nodes then holds every node once, in breadth-first order
+	bool LoadFromSnapshot(const string& snapshotPath, SnapshotValidation validation = SnapshotValidation::SizeAndTime)
+	{
+		if (!fs::is_regular_file(snapshotPath)) {
+			return false;
+		}
+
+		MappedFile snapshot(snapshotPath);
+		const auto header = HierarchySnapshotHeader::Parse(snapshot.data(), snapshot.size(), snapshotPath);
+		SnapshotReader reader(snapshot.data() + header.metadataOffset, static_cast<size_t>(header.metadataSize), snapshotPath);
+
+		OctreeFiles snapshotFiles;
+		snapshotFiles.metadata = reader.GetString();
+		snapshotFiles.hierarchy = reader.GetString();
+		snapshotFiles.octree = reader.GetString();
+		snapshotFiles.octreeEmbedded = reader.Get<uint8_t>() != 0;
+		snapshotFiles.octreeOffset = reader.Get<uint64_t>();
+		snapshotFiles.octreeSize = reader.Get<uint64_t>();
+		snapshotFiles.hierarchyOffset = reader.Get<uint64_t>();
+		snapshotFiles.hierarchySize = reader.Get<uint64_t>();
+
+		const uint64_t sourceCount = reader.Get<uint64_t>();
+		for (uint64_t i = 0; i < sourceCount; ++i)
+		{
+			SnapshotSourceStamp stamp;
+			stamp.path = reader.GetString();
+			stamp.size = reader.Get<uint64_t>();
+			stamp.modified = reader.Get<int64_t>();
+			stamp.hash = reader.Get<uint64_t>();
+
+			if (!stamp.Matches(validation)) {
+				return false;
+			}
+		}
+
+		auto getVector = [&reader]() {
+			const double x = reader.Get<double>();
+			const double y = reader.Get<double>();
+			const double z = reader.Get<double>();
+			return Vector3(x, y, z);
+		};
+
+		// Everything is parsed and checked before the octree is changed, so a damaged snapshot leaves it as it was
+		const string snapshotVersion = reader.GetString();
+		const string snapshotName = reader.GetString();
+		const string snapshotDescription = reader.GetString();
+		const int64_t snapshotPoints = reader.Get<int64_t>();
+
+		OctreeGeometry parsed;
+		parsed.url = reader.GetString();
+		parsed.projection = reader.GetString();
+		parsed.spacing = reader.Get<double>();
+		for (auto* box : { &parsed.boundingBox, &parsed.tightBoundingBox })
+		{
+			box->min = getVector();
+			box->max = getVector();
+		}
+		for (auto* values : { &parsed.offset, &parsed.scale })
+		{
+			values->resize(static_cast<size_t>(reader.Get<uint64_t>()));
+			for (double& value : *values) {
+				value = reader.Get<double>();
+			}
+		}
+
+		Attributes& attributes = parsed.pointAttributes;
+		attributes.bytes = reader.Get<int32_t>();
+		attributes.posScale = getVector();
+		attributes.posOffset = getVector();
+		attributes.list.resize(static_cast<size_t>(reader.Get<uint64_t>()));
+		for (auto& attribute : attributes.list)
+		{
+			attribute.name = reader.GetString();
+			attribute.description = reader.GetString();
+			attribute.size = reader.Get<int32_t>();
+			attribute.numElements = reader.Get<int32_t>();
+			attribute.elementSize = reader.Get<int32_t>();
+			attribute.type = static_cast<AttributeType>(reader.Get<int32_t>());
+			attribute.min = getVector();
+			attribute.max = getVector();
+		}
+
+		Hierarchy parsedHierarchy;
+		parsedHierarchy.firstChunkSize = reader.Get<int64_t>();
+		parsedHierarchy.stepSize = reader.Get<int64_t>();
+		parsedHierarchy.depth = reader.Get<int64_t>();
+
+		OctreeNodeTable table;
+		table.rootBoundingBox = parsed.boundingBox;
+		table.rootSpacing = parsed.spacing;
+
+		vector<size_t> elementSizes;
+		table.ForEachArray([&elementSizes](const auto& values) { elementSizes.push_back(sizeof(values[0])); });
+		const auto offsets = header.ArrayOffsets(elementSizes);
+		if (offsets.back() > snapshot.size()) {
+			throw std::runtime_error("Hierarchy snapshot node arrays reach beyond the end of the file: " + snapshotPath);
+		}
+
+		size_t array = 0;
+		table.ForEachArray([&](auto& values) {
+			values.resize(static_cast<size_t>(header.nodeCount));
+			memcpy(values.data(), snapshot.data() + offsets[array++], values.size() * sizeof(values[0]));
+		});
+		table.Validate(snapshotPath);
+
+		files = snapshotFiles;
+		octreeSource.reset();
+
+		version = snapshotVersion;
+		name = snapshotName;
+		description = snapshotDescription;
+		points = snapshotPoints;
+
+		geometry.url = std::move(parsed.url);
+		geometry.projection = std::move(parsed.projection);
+		geometry.spacing = parsed.spacing;
+		geometry.boundingBox = parsed.boundingBox;
+		geometry.tightBoundingBox = parsed.tightBoundingBox;
+		geometry.offset = std::move(parsed.offset);
+		geometry.scale = std::move(parsed.scale);
+		geometry.pointAttributes = std::move(parsed.pointAttributes);
+		hierarchy = parsedHierarchy;
+
+		geometry.lazyHierarchy.reset();
+		if (hierarchyLoading == HierarchyLoading::Table)
+		{
+			geometry.nodeTable = std::make_shared<OctreeNodeTable>(std::move(table));
+			if (buildNodeIndex) {
+				geometry.nodeTable->BuildIndex();
+			}
+			geometry.root.reset();
+			geometry.nodes.clear();
+			geometry.nodeIndex.reset();
+			geometry.traversableNodes = static_cast<int64_t>(geometry.nodeTable->size());
+		}
+		else
+		{
+			geometry.nodeTable.reset();
+			BuildNodesFromTable(table);
+		}
+
+		return true;
+	}
+
 	const OctreeGeometry& Geometry() const
 	{
 		return this->geometry;
@@ -431,6 +996,106 @@ public:
 		SearchOctreeFiles(metadataFilePath);
 		json metadata = loadMetadataJson(metadataFilePath);
 
+		LoadMetadata(metadata);
+
+		// Load all chunks of the hierarchy using the hierarchy file, starting from root
+		LoadHierarchyNodes(this->files.hierarchy);
+
+		// ToDo: Test filesize of octree.bin against last byte according to hierarchy
+	}
+
+	// Loads the octree from a packed octree file, see PackedOctreeFile.h. Metadata and hierarchy are read
+	// through one file handle, OctreeLoader then reads node data from the octree section of the same file
+	void LoadFromPackedFile(const string& packedFilePath)
+	{
+		const uint64_t fileSize = std::filesystem::file_size(packedFilePath);
+		PositionalFile packed(packedFilePath);
+		auto header = PackedOctreeHeader::Read(packed, fileSize, packedFilePath);
+
+		LoadEmbeddedFiles(packed, packedFilePath, header.metadata, header.hierarchy, header.octree);
+	}
+
+	// Loads the octree from an uncompressed zip or tar archive without extracting it. The octree files are found by name like
+	// in SearchOctreeFiles, hierarchy and octree data next to the first metadata file. Node data is read in place from the archive
+	void LoadFromArchive(const string& archivePath)
+	{
+		const uint64_t fileSize = std::filesystem::file_size(archivePath);
+		PositionalFile archive(archivePath);
+		ArchiveIndex index(archive, fileSize, archivePath);
+
+		auto folder = [](const string& entryName) {
+			const size_t slash = entryName.rfind('/');
+			return slash == string::npos ? string() : entryName.substr(0, slash + 1);
+		};
+
+		auto find = [&](const string& kind, const string& inFolder) {
+			return index.Find([&](const string& entryName) {
+				const string entryFolder = folder(entryName);
+				return (inFolder == "*" || entryFolder == inFolder) && octree_files::OctreeFileKind(entryName.substr(entryFolder.size())) == kind;
+				});
+		};
+
+		const ArchiveEntry* metadataEntry = find("metadata", "*");
+		if (metadataEntry == nullptr) {
+			throw std::invalid_argument("No metadata file found in archive: " + archivePath);
+		}
+
+		const string datasetFolder = folder(metadataEntry->name);
+		const ArchiveEntry* hierarchyEntry = find("hierarchy", datasetFolder);
+		const ArchiveEntry* octreeEntry = find("octree", datasetFolder);
+		if (hierarchyEntry == nullptr || octreeEntry == nullptr) {
+			throw std::invalid_argument("No hierarchy or octree file next to " + metadataEntry->name + " in archive: " + archivePath);
+		}
+
+		LoadEmbeddedFiles(archive, archivePath, index.Locate(archive, *metadataEntry), index.Locate(archive, *hierarchyEntry), index.Locate(archive, *octreeEntry));
+	}
+
+	// Loads the octree from sources which do not have to be local files, e.g. MemoryByteSource or HttpByteSource
+	void LoadFromByteSources(std::shared_ptr<ByteSource> metadataSource, std::shared_ptr<ByteSource> hierarchySource, std::shared_ptr<ByteSource> octreeDataSource)
+	{
+		this->geometry.url = metadataSource->Name();
+		files.metadata  = metadataSource->Name();
+		files.hierarchy = hierarchySource->Name();
+		files.octree    = octreeDataSource->Name();
+		octreeSource    = std::move(octreeDataSource);
+
+		auto metadataText = metadataSource->ReadAll();
+		json metadata = json::parse(metadataText.begin(), metadataText.end());
+
+		LoadMetadata(metadata);
+		LoadHierarchyNodes(hierarchySource);
+	}
+
+private:
+	// Loads metadata and hierarchy from sections of one file and points files.octree at the octree section
+	void LoadEmbeddedFiles(const PositionalFile& file, const string& path, const PackedSection& metadata, const PackedSection& hierarchy, const PackedSection& octree)
+	{
+		this->geometry.url = path;
+		files.metadata  = path;
+		files.hierarchy = path;
+		files.octree    = path;
+		files.octreeEmbedded = true;
+		files.octreeOffset = octree.offset;
+		files.octreeSize   = octree.size;
+		files.hierarchyOffset = hierarchy.offset;
+		files.hierarchySize   = hierarchy.size;
+
+		string metadataText(static_cast<size_t>(metadata.size), '\0');
+		metadataText.resize(file.readAt(metadata.offset, metadata.size, reinterpret_cast<uint8_t*>(metadataText.data())));
+		LoadMetadata(json::parse(metadataText));
+
+		if (hierarchyLoading == HierarchyLoading::Lazy) {
+			LoadHierarchyNodes(std::make_shared<FileByteSource>(path, hierarchy.offset, hierarchy.size));
+			return;
+		}
+
+		auto buffer = make_shared<Buffer>(static_cast<int64_t>(hierarchy.size));
+		buffer->size = static_cast<int64_t>(file.readAt(hierarchy.offset, hierarchy.size, buffer->data_u8));
+		LoadHierarchyNodes(buffer);
+	}
+
+	void LoadMetadata(const json& metadata)
+	{
 		this->geometry.pointAttributes = parseMetadataAtrributes(metadata);
 		{
 			auto& scale = this->geometry.pointAttributes.posScale;
@@ -455,60 +1120,108 @@ public:
 		};
 
 		geometry.tightBoundingBox = geometry.boundingBox;
-
-		// Load all chunks of the hierarchy using the hierarchy file, starting from root
-		LoadHierarchyNodes(this->files.hierarchy);
-
-		// ToDo: Test filesize of octree.bin against last byte according to hierarchy
 	}
 
+public:
 	std::vector<shared_ptr<OctreeGeometryNode>>& LoadHierarchyNodes(std::string hierarchyFile)
 	{
+		if (hierarchyLoading == HierarchyLoading::Lazy) {
+			return LoadHierarchyNodes(std::make_shared<FileByteSource>(hierarchyFile));
+		}
+
 		return LoadHierarchyNodes(readBinaryFile(hierarchyFile));
 	}
 
+	// With HierarchyLoading::Lazy only the first chunk is read here, the source is kept to read the other chunks on demand.
+	// geometry.nodes then only holds the nodes of the first chunk
+	std::vector<shared_ptr<OctreeGeometryNode>>& LoadHierarchyNodes(std::shared_ptr<ByteSource> hierarchySource)
+	{
+		if (hierarchyLoading == HierarchyLoading::Lazy)
+		{
+			CreateRootNode();
+			geometry.nodeTable.reset();
+			geometry.lazyHierarchy = std::make_shared<LazyHierarchy>(hierarchySource);
+			geometry.nodeIndex.reset();
+			if (buildNodeIndex)
+			{
+				geometry.nodeIndex = std::make_shared<OctreeNodeIndex<OctreeGeometryNode*>>();
+				geometry.nodeIndex->Insert(geometry.root->key, geometry.root.get());
+			}
+			geometry.root->pendingChunk = true;
+			geometry.root->expand();
+
+			// Nodes of the first chunk, without reading further chunks
+			geometry.nodes.clear();
+			std::vector<OctreeGeometryNode*> stack{ geometry.root.get() };
+			while (!stack.empty())
+			{
+				auto* node = stack.back();
+				stack.pop_back();
+				geometry.nodes.push_back(shared_ptr<OctreeGeometryNode>(geometry.root, node));
+
+				for (auto* child : node->children) {
+					if (child != nullptr) {
+						stack.push_back(child);
+					}
+				}
+			}
+
+			geometry.traversableNodes = static_cast<int64_t>(geometry.nodes.size());
+			return geometry.nodes;
+		}
+
+		auto buffer = make_shared<Buffer>(static_cast<int64_t>(hierarchySource->Size()));
+		buffer->size = static_cast<int64_t>(hierarchySource->ReadAt(0, hierarchySource->Size(), buffer->data_u8));
+		return LoadHierarchyNodes(buffer);
+	}
+
 	std::vector<shared_ptr<OctreeGeometryNode>>& LoadHierarchyNodes(shared_ptr<Buffer> buffer)
 	{
 		const auto bytesPerNode = 22;
 
-		// Create octree geometry root
-		this->geometry.root = make_shared< OctreeGeometryNode>("r", &geometry, geometry.boundingBox);
-
-		this->geometry.root->level = 0;
-		this->geometry.root->nodeType = NODETYPE::PROXY;
-		this->geometry.root->byteOffset = 0; //hierarchyByteOffset
-		this->geometry.root->byteSize = hierarchy.firstChunkSize; //hierarchyByteSize
-		this->geometry.root->spacing = geometry.spacing;
-		this->geometry.root->byteOffset = 0;
+		if (hierarchyLoading == HierarchyLoading::Table)
+		{
+			geometry.nodeTable = std::make_shared<OctreeNodeTable>(OctreeNodeTable::Load(buffer->data_u8, static_cast<size_t>(buffer->size), hierarchy.firstChunkSize, geometry.boundingBox, geometry.spacing));
+			if (buildNodeIndex) {
+				geometry.nodeTable->BuildIndex();
+			}
+			geometry.root.reset();
+			geometry.nodes.clear();
+			geometry.nodeIndex.reset();
+			geometry.traversableNodes = static_cast<int64_t>(geometry.nodeTable->size());
+			return geometry.nodes;
+		}
 
-		auto* root = &this->geometry.root;
+		CreateRootNode();
+		geometry.lazyHierarchy.reset();
+		geometry.nodeTable.reset();
 
 		// Load Hierarchy
 		this->geometry.nodes.resize(0);
 		this->geometry.nodes.reserve(buffer->size / bytesPerNode);
-		vector<int64_t> chunkStarts;
-		chunkStarts.reserve(this->geometry.nodes.capacity());
-
-		auto offset = 0;
 		auto& geometryNodes = this->geometry.nodes;
-		int64_t chunk_start = 0; // Can be used to save all chunk starts
 
-		while (geometryNodes.size() < geometryNodes.capacity())
+		// Chunks are parsed in waves, a wave holds the chunks of all proxies found in the previous wave. Chunks of one wave
+		// are independent and parsed in parallel. Appending them in proxy order gives the node order of parsing one chunk
+		// after another, where the next chunk is always the one of the first proxy not parsed yet
+		vector<shared_ptr<OctreeGeometryNode>> wave{ geometry.root };
+
+		while (!wave.empty())
 		{
-			auto chunkNodes = CreateHierarchyNodes(*root, buffer.get());
-			chunk_start = geometryNodes.size();
-			geometryNodes.insert(geometryNodes.end(), chunkNodes.begin(), chunkNodes.end());
+			auto chunks = ParseHierarchyChunks(wave, buffer.get());
 
-			for (; offset < geometryNodes.size(); ++offset)
+			wave.clear();
+			for (auto& chunkNodes : chunks)
 			{
-				if (geometryNodes[offset]->nodeType == NODETYPE::PROXY)
+				geometryNodes.insert(geometryNodes.end(), chunkNodes.begin(), chunkNodes.end());
+
+				for (auto& node : chunkNodes)
 				{
-					root = &geometryNodes[offset];
-					break;
+					if (node->nodeType == NODETYPE::PROXY) {
+						wave.push_back(node);
+					}
 				}
 			}
-
-			++offset;
 		}
 
 		
@@ -518,12 +1231,216 @@ public:
 			});
 
 		geometry.traversableNodes = traversableNodes;
+		BuildNodeIndex();
 		return this->geometry.nodes;
 	}
 	
+private:
+	// Parses the chunks of the given proxies, on hierarchyThreads threads if there is more than one chunk.
+	// Each chunk only touches its own proxy and the nodes it creates, so chunks need no synchronization
+	vector<vector<shared_ptr<OctreeGeometryNode>>> ParseHierarchyChunks(vector<shared_ptr<OctreeGeometryNode>>& proxies, Buffer* buffer) const
+	{
+		vector<vector<shared_ptr<OctreeGeometryNode>>> chunks(proxies.size());
+
+		// Small waves are not worth starting threads for
+		constexpr int64_t minRecordsPerThread = 4096;
+		int64_t records = 0;
+		for (const auto& proxy : proxies) {
+			records += proxy->byteSize / 22;
+		}
+
+		unsigned threadCount = hierarchyThreads > 0 ? hierarchyThreads : std::thread::hardware_concurrency();
+		threadCount = static_cast<unsigned>((std::min)({ static_cast<int64_t>((std::max)(threadCount, 1u)), static_cast<int64_t>(proxies.size()), records / minRecordsPerThread }));
+
+		if (threadCount <= 1)
+		{
+			for (size_t i = 0; i < proxies.size(); ++i) {
+				chunks[i] = CreateHierarchyNodes(proxies[i], buffer);
+			}
+			return chunks;
+		}
+
+		std::atomic<size_t> nextChunk{ 0 };
+		std::atomic<bool> failed{ false };
+		std::exception_ptr error;
+		std::mutex errorMutex;
+
+		auto worker = [&]() {
+			while (!failed)
+			{
+				const size_t index = nextChunk++;
+				if (index >= proxies.size()) {
+					return;
+				}
+
+				try {
+					chunks[index] = CreateHierarchyNodes(proxies[index], buffer);
+				}
+				catch (...) {
+					std::lock_guard<std::mutex> lock(errorMutex);
+					if (!error) {
+						error = std::current_exception();
+					}
+					failed = true;
+				}
+			}
+		};
+
+		std::vector<std::thread> workers;
+		workers.reserve(threadCount);
+
+		for (unsigned i = 0; i < threadCount; ++i) {
+			workers.emplace_back(worker);
+		}
+
+		for (auto& thread : workers) {
+			thread.join();
+		}
+
+		if (error) {
+			std::rethrow_exception(error);
+		}
+
+		return chunks;
+	}
+
+	// Node table of the node objects, expanding pending proxies of a lazy hierarchy
+	OctreeNodeTable BuildTableFromNodes() const
+	{
+		OctreeNodeTable table;
+		table.rootBoundingBox = geometry.boundingBox;
+		table.rootSpacing = geometry.spacing;
+
+		if (!geometry.root) {
+			return table;
+		}
+
+		// Breadth first, children in octant order like OctreeNodeTable::Load
+		vector<OctreeGeometryNode*> order{ geometry.root.get() };
+		table.parent.push_back(OctreeNodeTable::npos);
+
+		for (size_t i = 0; i < order.size(); ++i)
+		{
+			auto* node = order[i];
+			node->expand();
+
+			if (node->byteSize > UINT32_MAX || order.size() >= OctreeNodeTable::npos) {
+				throw std::out_of_range("Node does not fit into the node table: " + node->name());
+			}
+
+			table.byteOffset.push_back(static_cast<uint64_t>(node->byteOffset));
+			table.byteSize.push_back(static_cast<uint32_t>(node->byteSize));
+			table.numPoints.push_back(static_cast<uint32_t>(node->numPoints));
+			table.firstChild.push_back(static_cast<uint32_t>(order.size()));
+			table.level.push_back(static_cast<uint8_t>(node->level));
+			table.nodeType.push_back(static_cast<uint8_t>(node->nodeType));
+
+			uint8_t childMask = 0;
+			for (size_t octant = 0; octant < node->children.size(); ++octant)
+			{
+				if (node->children[octant] != nullptr)
+				{
+					childMask |= static_cast<uint8_t>(1 << octant);
+					order.push_back(node->children[octant]);
+					table.parent.push_back(static_cast<uint32_t>(i));
+				}
+			}
+			table.childMask.push_back(childMask);
+		}
+
+		return table;
+	}
+
+	// Creates the node objects of a node table, geometry.nodes in table order
+	void BuildNodesFromTable(const OctreeNodeTable& table)
+	{
+		CreateRootNode();
+		geometry.nodes.assign(table.size(), nullptr);
+		if (table.size() == 0) {
+			geometry.traversableNodes = 0;
+			geometry.nodeIndex.reset();
+			return;
+		}
+		geometry.nodes[0] = geometry.root;
+
+		for (size_t index = 0; index < table.size(); ++index)
+		{
+			auto& node = geometry.nodes[index];
+			node->byteOffset = static_cast<int64_t>(table.byteOffset[index]);
+			node->byteSize = static_cast<int64_t>(table.byteSize[index]);
+			node->numPoints = static_cast<int64_t>(table.numPoints[index]);
+			node->nodeType = static_cast<NODETYPE>(table.nodeType[index]);
+
+			if (table.childMask[index] == 0) {
+				continue;
+			}
+
+			node->children.resize(8);
+			uint32_t childIndex = table.firstChild[index];
+			for (int octant = 0; octant < 8; ++octant)
+			{
+				if (((table.childMask[index] >> octant) & 1) == 0) {
+					continue;
+				}
+
+#if POTREELOADER_IMPLICIT_BOUNDING_BOXES
+				auto child = make_shared< OctreeGeometryNode>(node->key.child(octant), &geometry);
+#else
+				auto child = make_shared< OctreeGeometryNode>(node->key.child(octant), &geometry, createChildAABB(node->boundingBox, octant));
+#endif
+				child->spacing = node->spacing / 2;
+				child->level = node->level + 1;
+				child->parent = node.get();
+
+				node->children[octant] = child.get();
+				geometry.nodes[childIndex++] = std::move(child);
+			}
+		}
+
+		geometry.traversableNodes = static_cast<int64_t>(table.size());
+		BuildNodeIndex();
+	}
+
+	// Indexes geometry.nodes, which hold every node of a completely loaded hierarchy (proxies twice, as the same object)
+	void BuildNodeIndex()
+	{
+		geometry.nodeIndex.reset();
+		if (!buildNodeIndex) {
+			return;
+		}
+
+		geometry.nodeIndex = std::make_shared<OctreeNodeIndex<OctreeGeometryNode*>>(static_cast<size_t>(geometry.traversableNodes));
+		auto& index = *geometry.nodeIndex;
+		const auto& nodes = geometry.nodes;
+		for (size_t i = 0; i < nodes.size(); ++i)
+		{
+			if (i + index.prefetchDistance < nodes.size()) {
+				index.Prefetch(nodes[i + index.prefetchDistance]->key);
+			}
+			index.Insert(nodes[i]->key, nodes[i].get());
+		}
+	}
+
+	void CreateRootNode()
+	{
+		// Create octree geometry root
+		this->geometry.root = make_shared< OctreeGeometryNode>(OctreeNodeKey::Root(), &geometry, geometry.boundingBox);
+
+		this->geometry.root->level = 0;
+		this->geometry.root->nodeType = NODETYPE::PROXY;
+		this->geometry.root->byteOffset = 0; //hierarchyByteOffset
+		this->geometry.root->byteSize = hierarchy.firstChunkSize; //hierarchyByteSize
+		this->geometry.root->spacing = geometry.spacing;
+	}
+
+public:
 	std::vector<OctreeGeometryNode*> TraversableNodeReferences()
 	{
 		std::vector<OctreeGeometryNode*> traversableNodeRefs;
+		if (!geometry.root) {
+			return traversableNodeRefs;
+		}
+
 		traversableNodeRefs.reserve(geometry.traversableNodes);
 		int64_t traversableNodes = 0;
 		
@@ -533,6 +1450,155 @@ public:
 
 		return traversableNodeRefs;
 	}
+
+	// Node with the given key, nullptr if the hierarchy has no such node. Constant time through geometry.nodeIndex,
+	// see buildNodeIndex. With HierarchyLoading::Lazy the chunks on the way to the node are loaded first.
+	// HierarchyLoading::Table has no node objects, use geometry.nodeTable->Find there
+	OctreeGeometryNode* FindNode(const OctreeNodeKey& key) const
+	{
+		if (!geometry.nodeIndex)
+		{
+			OctreeGeometryNode* node = geometry.root.get();
+			for (int depth = 1; node != nullptr && depth <= key.level(); ++depth)
+			{
+				node->expand();
+				const size_t octant = static_cast<size_t>(key.octant(depth));
+				node = octant < node->children.size() ? node->children[octant] : nullptr;
+			}
+
+			if (node != nullptr) {
+				node->expand();
+			}
+			return node;
+		}
+
+		if (!geometry.lazyHierarchy) {
+			return geometry.nodeIndex->Find(key);
+		}
+
+		// A missing node may sit in a chunk which is not loaded yet. Its deepest loaded ancestor is then a pending proxy,
+		// which is expanded before looking again. Expanding takes the index lock exclusively, so it happens outside the lock.
+		// The proxy is checked under the lock: a chunk is indexed before its proxy stops pending, so a proxy which does not
+		// pend while the lock is held has all of its nodes in the index
+		while (true)
+		{
+			OctreeGeometryNode* node = nullptr;
+			OctreeGeometryNode* ancestor = nullptr;
+			bool ancestorPending = false;
+			{
+				std::shared_lock<std::shared_mutex> lock(geometry.lazyHierarchy->IndexMutex());
+				node = geometry.nodeIndex->Find(key);
+				for (int level = key.level() - 1; node == nullptr && ancestor == nullptr && level >= 0; --level) {
+					ancestor = geometry.nodeIndex->Find(key.ancestor(level));
+				}
+				ancestorPending = ancestor != nullptr && ancestor->pendingChunk.load(std::memory_order_acquire);
+			}
+
+			if (node != nullptr)
+			{
+				node->expand();
+				return node;
+			}
+			if (!ancestorPending) {
+				return nullptr;
+			}
+
+			ancestor->expand();
+		}
+	}
+
+	// Node with a name like "r0426". Throws std::invalid_argument for malformed names
+	OctreeGeometryNode* FindNode(std::string_view name) const
+	{
+		return FindNode(OctreeNodeKey::FromName(name));
+	}
+
+	// Looks up many nodes at once, see OctreeNodeIndex::Find. Entries are nullptr for nodes the hierarchy does not have
+	std::vector<OctreeGeometryNode*> FindNodes(const std::vector<OctreeNodeKey>& keys) const
+	{
+		if (geometry.nodeIndex && !geometry.lazyHierarchy) {
+			return geometry.nodeIndex->Find(keys);
+		}
+
+		if (!geometry.nodeIndex)
+		{
+			std::vector<OctreeGeometryNode*> nodes(keys.size());
+			for (size_t i = 0; i < keys.size(); ++i) {
+				nodes[i] = FindNode(keys[i]);
+			}
+			return nodes;
+		}
+
+		std::vector<OctreeGeometryNode*> nodes;
+		{
+			std::shared_lock<std::shared_mutex> lock(geometry.lazyHierarchy->IndexMutex());
+			nodes = geometry.nodeIndex->Find(keys);
+		}
+
+		// Nodes of chunks not loaded yet and pending proxies take the single node path
+		for (size_t i = 0; i < keys.size(); ++i)
+		{
+			if (nodes[i] == nullptr || nodes[i]->pendingChunk.load(std::memory_order_acquire)) {
+				nodes[i] = FindNode(keys[i]);
+			}
+		}
+		return nodes;
+	}
+
+	std::vector<OctreeGeometryNode*> FindNodes(const std::vector<string>& names) const
+	{
+		std::vector<OctreeNodeKey> keys;
+		keys.reserve(names.size());
+		for (const auto& nodeName : names) {
+			keys.push_back(OctreeNodeKey::FromName(nodeName));
+		}
+		return FindNodes(keys);
+	}
+
+	// Calls callback(node, containment) for the nodes within levels whose box is not outside the region, see QueryRegion in
+	// OctreeRegionQuery.h. Only Partial nodes need a point test, e.g. with OctreeLoader::SelectPointsInRegion.
+	// In HierarchyLoading::Table mode query geometry.nodeTable->Root() with the free function instead
+	template<typename Region, typename Callback> requires std::invocable<Callback&, OctreeGeometryNode* const&, Containment>
+	void QueryRegion(const Region& region, Callback&& callback, const LevelRange& levels = LevelRange()) const
+	{
+		if (geometry.root) {
+			::QueryRegion(geometry.root.get(), region, std::forward<Callback>(callback), levels);
+		}
+	}
+
+	template<typename Region>
+	std::vector<RegionNode<OctreeGeometryNode*>> QueryRegion(const Region& region, const LevelRange& levels = LevelRange()) const
+	{
+		std::vector<RegionNode<OctreeGeometryNode*>> nodes;
+		QueryRegion(region, [&nodes](OctreeGeometryNode* node, Containment containment) {
+			nodes.push_back({ node, containment });
+		}, levels);
+		return nodes;
+	}
+
+	// Nodes down to the level whose spacing reaches targetSpacing, see SelectNodesForSpacing in OctreeDensitySelection.h
+	std::vector<OctreeGeometryNode*> SelectNodesForSpacing(double targetSpacing) const
+	{
+		return geometry.root ? ::SelectNodesForSpacing(geometry.root.get(), targetSpacing) : std::vector<OctreeGeometryNode*>();
+	}
+
+	template<typename Region>
+	std::vector<RegionNode<OctreeGeometryNode*>> SelectNodesForSpacing(const Region& region, double targetSpacing) const
+	{
+		return geometry.root ? ::SelectNodesForSpacing(geometry.root.get(), region, targetSpacing) : std::vector<RegionNode<OctreeGeometryNode*>>();
+	}
+
+	// Level of detail for a view under a point budget, see LodSelector. Reads no point data.
+	// In HierarchyLoading::Table mode use a LodSelector<OctreeTableNode> on geometry.nodeTable->Root() instead
+	LodSelection<OctreeGeometryNode*> SelectLod(const LodCamera& camera, const LodOptions& options = LodOptions()) const
+	{
+		LodSelector<OctreeGeometryNode*> selector;
+		LodSelection<OctreeGeometryNode*> selection;
+		if (geometry.root) {
+			selector.Select(geometry.root.get(), camera, options, selection);
+		}
+		return selection;
+	}
 	
 
 };
@@ -0,0 +1,371 @@
+#pragma once
+#ifndef OCTREEARCHIVE_H
+#define OCTREEARCHIVE_H
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <stdexcept>
+#include <functional>
+#include <filesystem>
+#include "PlatformFile.h"
+#include "PackedOctreeFile.h"
+
+// File inside an archive
+struct ArchiveEntry
+{
+	std::string name;         // Path inside the archive, with '/' as separator
+	uint64_t size = 0;        // Uncompressed size
+	uint64_t headerOffset = 0; // Zip: offset of the local file header. Tar: offset of the data
+	bool stored = true;       // False for compressed or encrypted zip entries, which can not be read in place
+};
+
+// Index of an uncompressed zip or tar archive. Entries are read in place, nothing is extracted.
+// Zip archives have to store the entries without compression (method 0), zip64 is supported.
+// Tar archives may use the ustar, GNU long name and pax formats
+class ArchiveIndex
+{
+public:
+	enum class Format { Zip, Tar };
+
+private:
+	std::string archive_name;
+	uint64_t archive_size = 0;
+	Format archive_format = Format::Zip;
+	std::vector<ArchiveEntry> entries;
+
+	static uint64_t LittleEndian(const uint8_t* source, int bytes)
+	{
+		uint64_t value = 0;
+		for (int i = 0; i < bytes; ++i) {
+			value |= static_cast<uint64_t>(source[i]) << (8 * i);
+		}
+		return value;
+	}
+
+	// Tar numbers are octal text, or base-256 if the high bit of the first byte is set
+	static uint64_t TarNumber(const uint8_t* source, size_t length)
+	{
+		uint64_t value = 0;
+
+		if (source[0] & 0x80)
+		{
+			value = source[0] & 0x7F;
+			for (size_t i = 1; i < length; ++i) {
+				value = (value << 8) | source[i];
+			}
+			return value;
+		}
+
+		for (size_t i = 0; i < length && source[i] != 0; ++i)
+		{
+			if (source[i] >= '0' && source[i] <= '7') {
+				value = (value << 3) | static_cast<uint64_t>(source[i] - '0');
+			}
+		}
+		return value;
+	}
+
+	static std::string TarString(const uint8_t* source, size_t length)
+	{
+		return std::string(reinterpret_cast<const char*>(source), strnlen(reinterpret_cast<const char*>(source), length));
+	}
+
+	std::vector<uint8_t> ReadRange(const PositionalFile& file, uint64_t offset, uint64_t size) const
+	{
+		if (offset > archive_size || size > archive_size - offset) {
+			throw std::runtime_error("Archive structure reaches beyond the end of the file: " + archive_name);
+		}
+
+		std::vector<uint8_t> buffer(static_cast<size_t>(size));
+		if (file.readAt(offset, size, buffer.data()) != size) {
+			throw std::runtime_error("Could not read archive: " + archive_name);
+		}
+		return buffer;
+	}
+
+	void ReadZip(const PositionalFile& file)
+	{
+		// The end of central directory record is at the end, followed by a comment of up to 64 KiB
+		const uint64_t eocdSize = 22;
+		const uint64_t tailSize = (std::min)(archive_size, eocdSize + 0xFFFF);
+		auto tail = ReadRange(file, archive_size - tailSize, tailSize);
+
+		if (tail.size() < eocdSize) {
+			throw std::runtime_error("Zip archive without central directory: " + archive_name);
+		}
+
+		size_t eocd = std::string::npos;
+		for (size_t i = tail.size() - eocdSize + 1; i-- > 0;)
+		{
+			if (LittleEndian(&tail[i], 4) == 0x06054b50) {
+				eocd = i;
+				break;
+			}
+		}
+
+		if (eocd == std::string::npos) {
+			throw std::runtime_error("Zip archive without central directory: " + archive_name);
+		}
+
+		uint64_t entryCount = LittleEndian(&tail[eocd + 10], 2);
+		uint64_t directorySize = LittleEndian(&tail[eocd + 12], 4);
+		uint64_t directoryOffset = LittleEndian(&tail[eocd + 16], 4);
+
+		// Zip64 archives store the real values in a separate record, found through the locator right before the end record
+		if (entryCount == 0xFFFF || directorySize == 0xFFFFFFFF || directoryOffset == 0xFFFFFFFF)
+		{
+			const uint64_t eocdPosition = archive_size - tailSize + eocd;
+			if (eocdPosition < 20) {
+				throw std::runtime_error("Zip64 archive without locator: " + archive_name);
+			}
+
+			auto locator = ReadRange(file, eocdPosition - 20, 20);
+			if (LittleEndian(&locator[0], 4) != 0x07064b50) {
+				throw std::runtime_error("Zip64 archive without locator: " + archive_name);
+			}
+
+			auto record = ReadRange(file, LittleEndian(&locator[8], 8), 56);
+			if (LittleEndian(&record[0], 4) != 0x06064b50) {
+				throw std::runtime_error("Invalid zip64 end of central directory: " + archive_name);
+			}
+
+			entryCount = LittleEndian(&record[32], 8);
+			directorySize = LittleEndian(&record[40], 8);
+			directoryOffset = LittleEndian(&record[48], 8);
+		}
+
+		auto directory = ReadRange(file, directoryOffset, directorySize);
+		entries.reserve(static_cast<size_t>((std::min)(entryCount, directorySize / 46)));
+
+		size_t position = 0;
+		for (uint64_t i = 0; i < entryCount; ++i)
+		{
+			if (position + 46 > directory.size() || LittleEndian(&directory[position], 4) != 0x02014b50) {
+				throw std::runtime_error("Invalid zip central directory: " + archive_name);
+			}
+
+			const uint8_t* record = &directory[position];
+			const uint64_t flags = LittleEndian(record + 8, 2);
+			const uint64_t method = LittleEndian(record + 10, 2);
+			uint64_t compressedSize = LittleEndian(record + 20, 4);
+			uint64_t size = LittleEndian(record + 24, 4);
+			const size_t nameLength = static_cast<size_t>(LittleEndian(record + 28, 2));
+			const size_t extraLength = static_cast<size_t>(LittleEndian(record + 30, 2));
+			const size_t commentLength = static_cast<size_t>(LittleEndian(record + 32, 2));
+			uint64_t headerOffset = LittleEndian(record + 42, 4);
+
+			if (position + 46 + nameLength + extraLength + commentLength > directory.size()) {
+				throw std::runtime_error("Invalid zip central directory: " + archive_name);
+			}
+
+			// Zip64 extra field, holding only the values which did not fit, in this order
+			const uint8_t* extra = record + 46 + nameLength;
+			for (size_t e = 0; e + 4 <= extraLength;)
+			{
+				const uint64_t id = LittleEndian(extra + e, 2);
+				const size_t length = static_cast<size_t>(LittleEndian(extra + e + 2, 2));
+				if (id == 0x0001)
+				{
+					const uint8_t* value = extra + e + 4;
+					const uint8_t* valueEnd = value + (std::min)(length, extraLength - e - 4);
+					for (uint64_t* field : { &size, &compressedSize, &headerOffset })
+					{
+						if (*field == 0xFFFFFFFF && value + 8 <= valueEnd) {
+							*field = LittleEndian(value, 8);
+							value += 8;
+						}
+					}
+				}
+				e += 4 + length;
+			}
+
+			ArchiveEntry entry;
+			entry.name = std::string(reinterpret_cast<const char*>(record + 46), nameLength);
+			entry.size = size;
+			entry.headerOffset = headerOffset;
+			entry.stored = method == 0 && (flags & 0x1) == 0 && compressedSize == size;
+			entries.push_back(std::move(entry));
+
+			position += 46 + nameLength + extraLength + commentLength;
+		}
+	}
+
+	void ReadTar(const PositionalFile& file)
+	{
+		const uint64_t block = 512;
+		std::string longName;
+		std::string paxName;
+		uint64_t paxSize = UINT64_MAX;
+
+		for (uint64_t position = 0; position + block <= archive_size;)
+		{
+			auto header = ReadRange(file, position, block);
+
+			// Two zero blocks end the archive, one is enough to stop
+			if (std::all_of(header.begin(), header.end(), [](uint8_t value) { return value == 0; })) {
+				break;
+			}
+
+			uint64_t size = TarNumber(&header[124], 12);
+			const char type = static_cast<char>(header[156]);
+			const uint64_t dataOffset = position + block;
+
+			if (type == 'L' || type == 'x')
+			{
+				auto content = ReadRange(file, dataOffset, size);
+
+				if (type == 'L') {
+					longName = TarString(content.data(), content.size());
+				}
+				else
+				{
+					// Records of the form "<length> <key>=<value>\n"
+					size_t record = 0;
+					while (record < content.size())
+					{
+						const size_t space = std::find(content.begin() + record, content.end(), ' ') - content.begin();
+						const size_t length = static_cast<size_t>(std::strtoull(std::string(content.begin() + record, content.begin() + space).c_str(), nullptr, 10));
+						if (length == 0 || record + length > content.size()) {
+							break;
+						}
+
+						const std::string keyValue(content.begin() + space + 1, content.begin() + record + length - 1);
+						const size_t equals = keyValue.find('=');
+						if (equals != std::string::npos)
+						{
+							const std::string key = keyValue.substr(0, equals);
+							if (key == "path") {
+								paxName = keyValue.substr(equals + 1);
+							}
+							else if (key == "size") {
+								paxSize = std::strtoull(keyValue.c_str() + equals + 1, nullptr, 10);
+							}
+						}
+						record += length;
+					}
+				}
+			}
+			else
+			{
+				if (paxSize != UINT64_MAX) {
+					size = paxSize;
+				}
+
+				if (type == '0' || type == '\0' || type == '7')
+				{
+					ArchiveEntry entry;
+					if (!paxName.empty()) {
+						entry.name = paxName;
+					}
+					else if (!longName.empty()) {
+						entry.name = longName;
+					}
+					else
+					{
+						const std::string prefix = memcmp(&header[257], "ustar", 5) == 0 ? TarString(&header[345], 155) : std::string();
+						const std::string name = TarString(&header[0], 100);
+						entry.name = prefix.empty() ? name : prefix + "/" + name;
+					}
+					entry.size = size;
+					entry.headerOffset = dataOffset;
+					entries.push_back(std::move(entry));
+				}
+
+				longName.clear();
+				paxName.clear();
+				paxSize = UINT64_MAX;
+			}
+
+			position = dataOffset + (size + block - 1) / block * block;
+		}
+	}
+
+public:
+	ArchiveIndex(const PositionalFile& file, uint64_t fileSize, const std::string& name) : archive_name(name), archive_size(fileSize)
+	{
+		uint8_t signature[512] = {};
+		const size_t bytes_read = file.readAt(0, sizeof(signature), signature);
+
+		if (bytes_read >= 4 && LittleEndian(signature, 4) == 0x04034b50) {
+			archive_format = Format::Zip;
+			ReadZip(file);
+		}
+		else if (bytes_read == sizeof(signature) && memcmp(signature + 257, "ustar", 5) == 0) {
+			archive_format = Format::Tar;
+			ReadTar(file);
+		}
+		else {
+			throw std::runtime_error("Not a zip or tar archive: " + name);
+		}
+	}
+
+	// Whether the file starts like a zip or ustar archive
+	static bool IsArchive(const std::string& path)
+	{
+		if (!std::filesystem::is_regular_file(path)) {
+			return false;
+		}
+
+		uint8_t signature[512] = {};
+		PositionalFile file(path);
+		const size_t bytes_read = file.readAt(0, sizeof(signature), signature);
+
+		return (bytes_read >= 4 && LittleEndian(signature, 4) == 0x04034b50)
+			|| (bytes_read == sizeof(signature) && memcmp(signature + 257, "ustar", 5) == 0);
+	}
+
+	Format ArchiveFormat() const
+	{
+		return archive_format;
+	}
+
+	const std::vector<ArchiveEntry>& Entries() const
+	{
+		return entries;
+	}
+
+	// First entry whose name matches, or nullptr
+	const ArchiveEntry* Find(const std::function<bool(const std::string&)>& match) const
+	{
+		for (const auto& entry : entries)
+		{
+			if (match(entry.name)) {
+				return &entry;
+			}
+		}
+		return nullptr;
+	}
+
+	// Position of the entry's bytes within the archive file
+	PackedSection Locate(const PositionalFile& file, const ArchiveEntry& entry) const
+	{
+		if (!entry.stored) {
+			throw std::runtime_error("Archive entry is compressed or encrypted and can not be read in place: " + entry.name);
+		}
+
+		PackedSection section;
+		section.size = entry.size;
+		section.offset = entry.headerOffset;
+
+		// Zip entries are preceded by a local header, whose name and extra field lengths may differ from the central directory
+		if (archive_format == Format::Zip)
+		{
+			auto header = ReadRange(file, entry.headerOffset, 30);
+			if (LittleEndian(&header[0], 4) != 0x04034b50) {
+				throw std::runtime_error("Invalid zip local header for: " + entry.name);
+			}
+			section.offset = entry.headerOffset + 30 + LittleEndian(&header[26], 2) + LittleEndian(&header[28], 2);
+		}
+
+		if (section.offset > archive_size || section.size > archive_size - section.offset) {
+			throw std::runtime_error("Archive entry reaches beyond the end of the file: " + entry.name);
+		}
+
+		return section;
+	}
+};
+
+#endif
@@ -0,0 +1,580 @@
+#pragma once
+#ifndef OCTREEASYNCREADER_H
+#define OCTREEASYNCREADER_H
+#include <vector>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <stdexcept>
+#include <system_error>
+#include <cstdint>
+#include <cstring>
+#include "PlatformFile.h"
+
+// io_uring is used through raw system calls, so no liburing is needed. Define POTREELOADER_NO_IO_URING to disable it
+#if defined(__linux__) && !defined(POTREELOADER_NO_IO_URING) && __has_include(<linux/io_uring.h>)
+	#define POTREELOADER_HAS_IO_URING 1
+	#include <linux/io_uring.h>
+	#include <sys/syscall.h>
+	#include <sys/uio.h>
+	#include <sys/mman.h>
+	#include <unistd.h>
+#else
+	#define POTREELOADER_HAS_IO_URING 0
+#endif
+
+enum class AsyncReadBackend {
+	Auto = 0,       // io_uring if the kernel supports it, thread pool otherwise
+	IoUring = 1,    // io_uring only, throws if it is not available
+	ThreadPool = 2, // Worker threads issuing positional reads
+};
+
+struct AsyncReadOptions
+{
+	AsyncReadBackend backend = AsyncReadBackend::Auto;
+	unsigned queueDepth = 32;  // Number of reads in flight at the same time
+	unsigned threadCount = 0;  // Worker threads of the thread pool backend, 0 uses queueDepth
+};
+
+// One byte range of the file. 'id' is handed back unchanged with the completion
+struct AsyncReadRequest
+{
+	uint64_t byteOffset;
+	uint64_t byteSize;
+	size_t id;
+};
+
+// Callback for completed reads. The data pointer is only valid during the call.
+// The callback is never invoked concurrently, no matter which backend is used
+using AsyncReadCallback = std::function<void(size_t id, const uint8_t* data, size_t size)>;
+
+#if POTREELOADER_HAS_IO_URING
+// Minimal submission/completion ring for read requests
+class IoUringQueue
+{
+	int ring_fd = -1;
+
+	void* sq_ring = nullptr;
+	void* cq_ring = nullptr;
+	size_t sq_ring_size = 0;
+	size_t cq_ring_size = 0;
+	io_uring_sqe* sqes = nullptr;
+	size_t sqes_size = 0;
+
+	unsigned* sq_head = nullptr;
+	unsigned* sq_tail = nullptr;
+	unsigned* sq_mask = nullptr;
+	unsigned* sq_array = nullptr;
+	unsigned sq_entries = 0;
+	unsigned to_submit = 0;
+
+	unsigned* cq_head = nullptr;
+	unsigned* cq_tail = nullptr;
+	unsigned* cq_mask = nullptr;
+	io_uring_cqe* cqes = nullptr;
+
+	void Release()
+	{
+		if (sqes != nullptr) ::munmap(sqes, sqes_size);
+		if (cq_ring != nullptr && cq_ring != sq_ring) ::munmap(cq_ring, cq_ring_size);
+		if (sq_ring != nullptr) ::munmap(sq_ring, sq_ring_size);
+		if (ring_fd >= 0) ::close(ring_fd);
+	}
+
+public:
+	IoUringQueue(unsigned entries)
+	{
+		io_uring_params params;
+		memset(&params, 0, sizeof(params));
+
+		ring_fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+		if (ring_fd < 0) {
+			throw std::runtime_error("io_uring_setup failed");
+		}
+
+		sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+		cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+		const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+		if (single_mmap) {
+			sq_ring_size = cq_ring_size = (std::max)(sq_ring_size, cq_ring_size);
+		}
+
+		sq_ring = ::mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+		if (sq_ring == MAP_FAILED) {
+			sq_ring = nullptr;
+			Release();
+			throw std::runtime_error("Could not map io_uring submission queue");
+		}
+
+		if (single_mmap) {
+			cq_ring = sq_ring;
+		}
+		else {
+			cq_ring = ::mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+			if (cq_ring == MAP_FAILED) {
+				cq_ring = nullptr;
+				Release();
+				throw std::runtime_error("Could not map io_uring completion queue");
+			}
+		}
+
+		sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+		void* sqes_ptr = ::mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+		if (sqes_ptr == MAP_FAILED) {
+			Release();
+			throw std::runtime_error("Could not map io_uring submission entries");
+		}
+		sqes = static_cast<io_uring_sqe*>(sqes_ptr);
+
+		auto* sq = static_cast<uint8_t*>(sq_ring);
+		sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+		sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+		sq_mask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+		sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+		sq_entries = params.sq_entries;
+
+		auto* cq = static_cast<uint8_t*>(cq_ring);
+		cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+		cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+		cq_mask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+		cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+	}
+
+	IoUringQueue(const IoUringQueue&) = delete;
+	IoUringQueue& operator=(const IoUringQueue&) = delete;
+
+	~IoUringQueue()
+	{
+		Release();
+	}
+
+	unsigned Capacity() const
+	{
+		return sq_entries;
+	}
+
+	// Queues a vectored read. The iovec has to stay alive until its completion was popped
+	bool PushRead(int fd, const iovec* vec, uint64_t offset, uint64_t user_data)
+	{
+		const unsigned tail = *sq_tail;
+		const unsigned head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+
+		if (tail - head >= sq_entries) {
+			return false;
+		}
+
+		const unsigned index = tail & *sq_mask;
+		io_uring_sqe* sqe = &sqes[index];
+		memset(sqe, 0, sizeof(*sqe));
+		sqe->opcode = IORING_OP_READV;
+		sqe->fd = fd;
+		sqe->addr = reinterpret_cast<uint64_t>(vec);
+		sqe->len = 1;
+		sqe->off = offset;
+		sqe->user_data = user_data;
+
+		sq_array[index] = index;
+		__atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+		++to_submit;
+
+		return true;
+	}
+
+	// Submits all queued reads and blocks until at least wait_count completions are available
+	void Submit(unsigned wait_count)
+	{
+		while (true)
+		{
+			const unsigned flags = wait_count > 0 ? IORING_ENTER_GETEVENTS : 0;
+			const long submitted = ::syscall(__NR_io_uring_enter, ring_fd, to_submit, wait_count, flags, nullptr, 0);
+
+			if (submitted < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				throw std::runtime_error("io_uring_enter failed");
+			}
+
+			to_submit -= static_cast<unsigned>(submitted);
+			return;
+		}
+	}
+
+	bool PopCompletion(uint64_t& user_data, int& result)
+	{
+		const unsigned head = *cq_head;
+		const unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+
+		if (head == tail) {
+			return false;
+		}
+
+		const io_uring_cqe& cqe = cqes[head & *cq_mask];
+		user_data = cqe.user_data;
+		result = cqe.res;
+		__atomic_store_n(cq_head, head + 1, __ATOMIC_RELEASE);
+
+		return true;
+	}
+};
+#endif
+
+// Worker threads of the thread pool backend. They live as long as the pool, so batches do not start threads of their own.
+// Threads are started by the first batch which needs them. One batch runs at a time
+class ReadWorkerPool
+{
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	std::vector<std::thread> threads;
+	const std::function<void()>* job = nullptr;
+	uint64_t batch = 0;        // Counts the batches, every worker looks at each batch once
+	unsigned batchWorkers = 0; // Workers with a lower index run the current batch
+	unsigned running = 0;
+	bool stopping = false;
+	std::atomic<bool> busy{ false };
+
+	void Work(unsigned index, uint64_t seen)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		while (true)
+		{
+			wake.wait(lock, [&]() { return stopping || batch != seen; });
+			if (stopping) {
+				return;
+			}
+
+			seen = batch;
+			if (index >= batchWorkers) {
+				continue;
+			}
+
+			const auto* current = job;
+			lock.unlock();
+			(*current)();
+			lock.lock();
+
+			if (--running == 0) {
+				done.notify_all();
+			}
+		}
+	}
+
+public:
+	ReadWorkerPool() = default;
+	ReadWorkerPool(const ReadWorkerPool&) = delete;
+	ReadWorkerPool& operator=(const ReadWorkerPool&) = delete;
+
+	~ReadWorkerPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		for (auto& thread : threads) {
+			thread.join();
+		}
+	}
+
+	// Runs work on workerCount threads and returns after all of them returned. work must not throw.
+	// Returns false without running anything if another batch is running, the caller then needs threads of its own
+	bool Run(const std::function<void()>& work, unsigned workerCount)
+	{
+		if (busy.exchange(true)) {
+			return false;
+		}
+
+		std::unique_lock<std::mutex> lock(mutex);
+		try {
+			while (threads.size() < workerCount) {
+				threads.emplace_back(&ReadWorkerPool::Work, this, static_cast<unsigned>(threads.size()), batch);
+			}
+		}
+		catch (...) {
+			busy = false;
+			throw;
+		}
+
+		job = &work;
+		batchWorkers = workerCount;
+		running = workerCount;
+		++batch;
+		wake.notify_all();
+
+		done.wait(lock, [this]() { return running == 0; });
+		job = nullptr;
+		lock.unlock();
+
+		busy = false;
+		return true;
+	}
+};
+
+// Reads many byte ranges of one file with several reads in flight at the same time
+class OctreeAsyncReader
+{
+	std::string file_path;
+	std::shared_ptr<PositionalFile> file;
+	std::shared_ptr<ReadWorkerPool> workers; // Threads of the thread pool backend, started per call without it
+
+public:
+	OctreeAsyncReader(const std::string& path) : file_path(path), file(std::make_shared<PositionalFile>(path)) {};
+
+	OctreeAsyncReader(const std::string& path, std::shared_ptr<PositionalFile> handle, std::shared_ptr<ReadWorkerPool> workerPool = nullptr)
+		: file_path(path), file(std::move(handle)), workers(std::move(workerPool)) {};
+
+	static bool IoUringAvailable()
+	{
+#if POTREELOADER_HAS_IO_URING
+		try {
+			IoUringQueue probe(1);
+			return true;
+		}
+		catch (const std::runtime_error&) {
+			return false;
+		}
+#else
+		return false;
+#endif
+	}
+
+	// Reads all requests and invokes the callback for each completed range, in completion order.
+	// Returns after the last callback. Reads beyond the end of the file deliver the bytes that exist
+	void Read(const std::vector<AsyncReadRequest>& requests, const AsyncReadCallback& callback, const AsyncReadOptions& options = AsyncReadOptions()) const
+	{
+		if (requests.empty()) {
+			return;
+		}
+
+		const unsigned queueDepth = (std::max)(options.queueDepth, 1u);
+
+#if POTREELOADER_HAS_IO_URING
+		if (options.backend != AsyncReadBackend::ThreadPool)
+		{
+			std::unique_ptr<IoUringQueue> ring;
+			try {
+				ring = std::make_unique<IoUringQueue>(queueDepth);
+			}
+			catch (const std::runtime_error&) {
+				if (options.backend == AsyncReadBackend::IoUring) {
+					throw;
+				}
+			}
+
+			if (ring) {
+				ReadIoUring(*ring, queueDepth, requests, callback);
+				return;
+			}
+		}
+#else
+		if (options.backend == AsyncReadBackend::IoUring) {
+			throw std::runtime_error("io_uring is not available on this platform");
+		}
+#endif
+
+		const unsigned threadCount = options.threadCount > 0 ? options.threadCount : queueDepth;
+		ReadThreadPool(requests, callback, threadCount);
+	}
+
+private:
+#if POTREELOADER_HAS_IO_URING
+	struct ReadSlot
+	{
+		std::vector<uint8_t> buffer;
+		iovec vec;
+		size_t request = 0;
+		size_t bytesDone = 0;
+		size_t bytesWanted = 0;
+	};
+
+	void ReadIoUring(IoUringQueue& ring, unsigned queueDepth, const std::vector<AsyncReadRequest>& requests, const AsyncReadCallback& callback) const
+	{
+		const int fd = file->native_handle();
+
+		// The kernel rounds the ring up to a power of two, queueDepth still limits the reads in flight
+		std::vector<ReadSlot> slots((std::min)(queueDepth, ring.Capacity()));
+		std::vector<size_t> freeSlots;
+		freeSlots.reserve(slots.size());
+
+		for (size_t i = slots.size(); i > 0; --i) {
+			freeSlots.push_back(i - 1);
+		}
+
+		auto queueRemainder = [&ring, fd](ReadSlot& slot, size_t slotIndex, uint64_t byteOffset) {
+			slot.vec.iov_base = slot.buffer.data() + slot.bytesDone;
+			slot.vec.iov_len = slot.bytesWanted - slot.bytesDone;
+			return ring.PushRead(fd, &slot.vec, byteOffset + slot.bytesDone, slotIndex);
+		};
+
+		size_t nextRequest = 0;
+		size_t inFlight = 0;
+		std::exception_ptr error;
+
+		// Deliver a completed range. After a failure nothing is delivered anymore, but reads
+		// in flight still have to complete before their buffers may be released
+		auto deliver = [&callback, &error](size_t id, const uint8_t* data, size_t size) {
+			if (error) {
+				return;
+			}
+			try {
+				callback(id, data, size);
+			}
+			catch (...) {
+				error = std::current_exception();
+			}
+		};
+
+		while ((!error && nextRequest < requests.size()) || inFlight > 0)
+		{
+			// Fill the queue
+			while (!error && nextRequest < requests.size() && !freeSlots.empty())
+			{
+				const auto& request = requests[nextRequest];
+				const size_t slotIndex = freeSlots.back();
+				auto& slot = slots[slotIndex];
+
+				slot.request = nextRequest;
+				slot.bytesDone = 0;
+				slot.bytesWanted = static_cast<size_t>(request.byteSize);
+				if (slot.buffer.size() < slot.bytesWanted) {
+					slot.buffer.resize(slot.bytesWanted);
+				}
+
+				if (slot.bytesWanted == 0) {
+					deliver(request.id, slot.buffer.data(), 0);
+					++nextRequest;
+					continue;
+				}
+
+				if (!queueRemainder(slot, slotIndex, request.byteOffset)) {
+					break;
+				}
+
+				freeSlots.pop_back();
+				++nextRequest;
+				++inFlight;
+			}
+
+			if (inFlight == 0) {
+				continue;
+			}
+
+			ring.Submit(1);
+
+			uint64_t slotIndex;
+			int result;
+			while (ring.PopCompletion(slotIndex, result))
+			{
+				auto& slot = slots[slotIndex];
+				const auto& request = requests[slot.request];
+
+				if (result == -EINTR || result == -EAGAIN) {
+					result = 0;
+				}
+				else if (result < 0) {
+					if (!error) {
+						// Like PositionalFile::readAt, so both backends fail a batch the same way
+						error = std::make_exception_ptr(std::system_error(-result, std::generic_category(), "Read failed for file: " + file_path));
+					}
+					result = 0;
+					slot.bytesWanted = slot.bytesDone;
+				}
+				else if (result == 0) {
+					// End of file, deliver what was read
+					slot.bytesWanted = slot.bytesDone;
+				}
+
+				slot.bytesDone += static_cast<size_t>(result);
+
+				if (slot.bytesDone < slot.bytesWanted)
+				{
+					// Short read, queue the rest. The ring has room since this completion freed an entry
+					queueRemainder(slot, static_cast<size_t>(slotIndex), request.byteOffset);
+					continue;
+				}
+
+				--inFlight;
+				deliver(request.id, slot.buffer.data(), slot.bytesDone);
+				freeSlots.push_back(static_cast<size_t>(slotIndex));
+			}
+		}
+
+		if (error) {
+			std::rethrow_exception(error);
+		}
+	}
+#endif
+
+	void ReadThreadPool(const std::vector<AsyncReadRequest>& requests, const AsyncReadCallback& callback, unsigned threadCount) const
+	{
+		std::atomic<size_t> nextRequest{ 0 };
+		std::atomic<bool> failed{ false };
+		std::exception_ptr error;
+		std::mutex callbackMutex;
+
+		auto worker = [&]() {
+			std::vector<uint8_t> buffer;
+
+			while (!failed)
+			{
+				const size_t index = nextRequest++;
+				if (index >= requests.size()) {
+					return;
+				}
+
+				const auto& request = requests[index];
+
+				try {
+					if (buffer.size() < request.byteSize) {
+						buffer.resize(static_cast<size_t>(request.byteSize));
+					}
+
+					const size_t bytesRead = file->readAt(request.byteOffset, request.byteSize, buffer.data());
+
+					std::lock_guard<std::mutex> lock(callbackMutex);
+					if (!failed) {
+						callback(request.id, buffer.data(), bytesRead);
+					}
+				}
+				catch (...) {
+					std::lock_guard<std::mutex> lock(callbackMutex);
+					if (!failed) {
+						error = std::current_exception();
+						failed = true;
+					}
+				}
+			}
+		};
+
+		const unsigned workerCount = static_cast<unsigned>((std::min)(static_cast<size_t>(threadCount), requests.size()));
+		const std::function<void()> work = worker;
+
+		// Without a pool, or while it serves a batch of another thread, the batch runs on threads of its own
+		if (!workers || !workers->Run(work, workerCount))
+		{
+			std::vector<std::thread> threads;
+			threads.reserve(workerCount);
+
+			for (unsigned i = 0; i < workerCount; ++i) {
+				threads.emplace_back(work);
+			}
+
+			for (auto& thread : threads) {
+				thread.join();
+			}
+		}
+
+		if (error) {
+			std::rethrow_exception(error);
+		}
+	}
+};
+
+#endif
@@ -2,6 +2,12 @@
 #ifndef OCTREEDATA_H
 #define OCTREEDATA_H
 #include <vector>
+#include <cstring>
+#include <cstdint>
+#include <memory>
+#include <algorithm>
+#include <mutex>
+#include <new>
 
 struct OctreeData {
 
@@ -48,9 +54,151 @@ struct OctreeData {
 	template<class T>
 	inline void set(T value, int64_t byte_position)
 	{
-		memcpy(data.data() + byte_position, &value, sizeof(T));
+		memcpy(data_raw.data() + byte_position, &value, sizeof(T));
 	}
 
 };
 
+// Non-owning view of a node's raw point data. 'guard' keeps the memory behind the view alive,
+// e.g. the memory mapping of octree.bin, so the view stays valid even if the loader is destroyed
+struct OctreeNodeView {
+
+	const uint8_t* data_ptr = nullptr;
+	size_t byte_size = 0;
+	std::shared_ptr<const void> guard;
+
+	OctreeNodeView() {}
+
+	OctreeNodeView(const uint8_t* data, size_t size, std::shared_ptr<const void> guard)
+		: data_ptr(data), byte_size(size), guard(std::move(guard)) {}
+
+	const uint8_t* data() const
+	{
+		return data_ptr;
+	}
+
+	size_t size() const
+	{
+		return byte_size;
+	}
+
+	bool empty() const
+	{
+		return byte_size == 0;
+	}
+
+	const uint8_t* begin() const
+	{
+		return data_ptr;
+	}
+
+	const uint8_t* end() const
+	{
+		return data_ptr + byte_size;
+	}
+};
+
+// Heap block with a fixed alignment, e.g. for reads which bypass the page cache
+class AlignedBuffer
+{
+	uint8_t* ptr = nullptr;
+	size_t buffer_capacity = 0;
+	size_t buffer_alignment = 0;
+
+public:
+	AlignedBuffer(size_t capacity, size_t alignment)
+		: ptr(static_cast<uint8_t*>(::operator new(capacity, std::align_val_t(alignment)))), buffer_capacity(capacity), buffer_alignment(alignment) {}
+
+	AlignedBuffer(const AlignedBuffer&) = delete;
+	AlignedBuffer& operator=(const AlignedBuffer&) = delete;
+
+	~AlignedBuffer()
+	{
+		::operator delete(ptr, std::align_val_t(buffer_alignment));
+	}
+
+	uint8_t* data()
+	{
+		return ptr;
+	}
+
+	size_t capacity() const
+	{
+		return buffer_capacity;
+	}
+};
+
+// Thread-safe pool of aligned buffers. Buffers handed out by Acquire go back into the pool once
+// their last reference is gone, so steady-state reads do not allocate
+class AlignedBufferPool : public std::enable_shared_from_this<AlignedBufferPool>
+{
+	size_t alignment;
+	size_t max_pooled;
+	std::mutex pool_mutex;
+	std::vector<std::unique_ptr<AlignedBuffer>> free_buffers;
+
+	AlignedBufferPool(size_t alignment, size_t maxPooled) : alignment(alignment), max_pooled(maxPooled) {}
+
+	void Release(AlignedBuffer* buffer)
+	{
+		std::unique_ptr<AlignedBuffer> owned(buffer);
+
+		std::lock_guard<std::mutex> lock(pool_mutex);
+		if (free_buffers.size() < max_pooled) {
+			free_buffers.push_back(std::move(owned));
+		}
+	}
+
+public:
+	static std::shared_ptr<AlignedBufferPool> Create(size_t alignment, size_t maxPooled = 64)
+	{
+		return std::shared_ptr<AlignedBufferPool>(new AlignedBufferPool(alignment, maxPooled));
+	}
+
+	size_t Alignment() const
+	{
+		return alignment;
+	}
+
+	// Returns a buffer of at least 'size' bytes, rounded up to the alignment
+	std::shared_ptr<AlignedBuffer> Acquire(size_t size)
+	{
+		const size_t capacity = (std::max)(alignment, (size + alignment - 1) / alignment * alignment);
+		std::unique_ptr<AlignedBuffer> buffer;
+
+		{
+			std::lock_guard<std::mutex> lock(pool_mutex);
+
+			// Take the smallest free buffer which is large enough
+			size_t best = free_buffers.size();
+			for (size_t i = 0; i < free_buffers.size(); ++i)
+			{
+				if (free_buffers[i]->capacity() >= capacity && (best == free_buffers.size() || free_buffers[i]->capacity() < free_buffers[best]->capacity())) {
+					best = i;
+				}
+			}
+
+			if (best < free_buffers.size()) {
+				buffer = std::move(free_buffers[best]);
+				free_buffers[best] = std::move(free_buffers.back());
+				free_buffers.pop_back();
+			}
+		}
+
+		if (!buffer) {
+			buffer = std::make_unique<AlignedBuffer>(capacity, alignment);
+		}
+
+		std::weak_ptr<AlignedBufferPool> pool = shared_from_this();
+		return std::shared_ptr<AlignedBuffer>(buffer.release(), [pool](AlignedBuffer* released) {
+			if (auto owner = pool.lock()) {
+				owner->Release(released);
+			}
+			else {
+				delete released;
+			}
+			});
+	}
+};
+
 #endif
\ No newline at end of file
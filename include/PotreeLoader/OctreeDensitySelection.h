@@ -0,0 +1,75 @@
+#pragma once
+#ifndef OCTREEDENSITYSELECTION_H
+#define OCTREEDENSITYSELECTION_H
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include "OctreeNodeKey.h"
+#include "OctreeTraversal.h"
+#include "OctreeRegionQuery.h"
+
+namespace octree_density
+{
+	template<typename Node>
+	double Spacing(const Node& node)
+	{
+		if constexpr (requires { node->spacing; }) {
+			return node->spacing;
+		}
+		else {
+			return node.spacing();
+		}
+	}
+}
+
+// Node spacing halves with every level, and the points of all levels down to a level are spaced like that level's nodes.
+// Returns the shallowest level whose spacing is at most targetSpacing, relative to a node of the given spacing
+inline int LevelsForSpacing(double nodeSpacing, double targetSpacing)
+{
+	if (!(targetSpacing > 0)) {
+		throw std::invalid_argument("Target spacing has to be positive");
+	}
+	if (nodeSpacing <= targetSpacing) {
+		return 0;
+	}
+
+	// log2 gives the level up to rounding, the loop settles the exact one
+	int levels = (std::max)(static_cast<int>(std::ceil(std::log2(nodeSpacing / targetSpacing))) - 1, 0);
+	while (levels < OctreeNodeKey::maxLevel && std::ldexp(nodeSpacing, -levels) > targetSpacing) {
+		++levels;
+	}
+	return levels;
+}
+
+// Deepest level the nodes under root need to reach targetSpacing
+template<typename Node>
+int LevelForSpacing(const Node& root, double targetSpacing)
+{
+	return OctreeTraversalTraits<Node>::Level(root) + LevelsForSpacing(octree_density::Spacing(root), targetSpacing);
+}
+
+// Minimal node set for points at targetSpacing: every node down to the level reaching it, depth-first pre-order.
+// Deeper nodes are never visited, so the selection costs as much as the result, and a lazy hierarchy loads no deeper chunks
+template<typename Node>
+std::vector<Node> SelectNodesForSpacing(const Node& root, double targetSpacing)
+{
+	std::vector<Node> nodes;
+	TraverseDepthFirst(root, [&nodes](const Node& node, int) {
+		nodes.push_back(node);
+	}, LevelRange::UpTo(LevelForSpacing(root, targetSpacing)));
+	return nodes;
+}
+
+// Like above, restricted to the nodes not outside the region. Partial nodes need a point test, see SelectPointsInRegion
+template<typename Node, typename Region>
+std::vector<RegionNode<Node>> SelectNodesForSpacing(const Node& root, const Region& region, double targetSpacing)
+{
+	std::vector<RegionNode<Node>> nodes;
+	QueryRegion(root, region, [&nodes](const Node& node, Containment containment) {
+		nodes.push_back({ node, containment });
+	}, LevelRange::UpTo(LevelForSpacing(root, targetSpacing)));
+	return nodes;
+}
+
+#endif
@@ -3,14 +3,150 @@
 #define OCTREEFILEREADER_H
 #include <vector>
 #include <string>
+#include <memory>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
 #include <filesystem>
+#include "OctreeData.h"
+#include "PlatformFile.h"
+#include "ByteSource.h"
+
+enum class ReaderMode {
+	PerCall = 0,    // Open and close the file for every read
+	Persistent = 1, // Open the file once and serve all reads with positional reads
+	MemoryMapped = 2, // Map the whole file into memory, reads are copies from the mapping and node views point into it
+	Direct = 3,     // Bypass the page cache (O_DIRECT), reads are expanded to aligned blocks from a buffer pool
+	Source = 4,     // Read from a ByteSource, e.g. memory or an HTTP server
+};
 
 struct OctreeFileReader
 {
 	std::string file_path;
-	size_t file_size;
+	size_t file_size;         // Size of the octree data, which is less than the file size if the data is embedded in a larger file
+	uint64_t file_offset = 0; // Start of the octree data within the file, e.g. in a packed octree file or an archive
+	ReaderMode mode;
+	std::shared_ptr<PositionalFile> file_handle; // Only used in ReaderMode::Persistent, shared between copies
+	std::shared_ptr<MappedFile> file_mapping;    // Only used in ReaderMode::MemoryMapped, shared between copies and node views
+	std::shared_ptr<AlignedBufferPool> buffer_pool; // Only used in ReaderMode::Direct
+	std::shared_ptr<ByteSource> byte_source;        // Only used in ReaderMode::Source
+	std::shared_ptr<ReadWorkerPool> read_workers = std::make_shared<ReadWorkerPool>(); // Thread pool backend of Read, shared between copies
+
+	static constexpr size_t direct_alignment = 4096;
 
-	OctreeFileReader(std::string path) : file_path(path), file_size(std::filesystem::file_size(path)) {};
+	OctreeFileReader(std::string path, ReaderMode mode = ReaderMode::PerCall) : OctreeFileReader(path, mode, 0, std::filesystem::file_size(path)) {};
+
+	// Reads octree data which is embedded in a larger file at [offset, offset + size). Node offsets stay relative to the octree data
+	OctreeFileReader(std::string path, ReaderMode mode, uint64_t offset, uint64_t size) : file_path(path), file_size(static_cast<size_t>(size)), file_offset(offset), mode(mode)
+	{
+		if (offset + size > std::filesystem::file_size(path)) {
+			throw std::out_of_range("Octree data reaches beyond the end of the file: " + path);
+		}
+
+		if (mode == ReaderMode::Persistent) {
+			file_handle = std::make_shared<PositionalFile>(file_path);
+		}
+		else if (mode == ReaderMode::MemoryMapped) {
+			file_mapping = std::make_shared<MappedFile>(file_path);
+		}
+		else if (mode == ReaderMode::Direct) {
+			file_handle = std::make_shared<PositionalFile>(file_path, true);
+			buffer_pool = AlignedBufferPool::Create(direct_alignment);
+		}
+	};
+
+	// Whether willNeed can reach the OS. Not the case for unbuffered and per-call readers
+	bool supportsHints() const
+	{
+		if (file_mapping) {
+			return true;
+		}
+#if !defined(_WIN32) && defined(POSIX_FADV_WILLNEED)
+		return file_handle && !buffer_pool;
+#else
+		return false;
+#endif
+	}
+
+	// Hints that the range will be read soon. Does nothing for unbuffered and per-call readers
+	bool willNeed(uint64_t byte_start, uint64_t byte_size) const
+	{
+		if (byte_start >= file_size) {
+			return false;
+		}
+
+		byte_size = (std::min)(byte_start + byte_size, static_cast<uint64_t>(file_size)) - byte_start;
+
+		if (file_mapping) {
+			return file_mapping->WillNeed(file_offset + byte_start, byte_size);
+		}
+		if (file_handle && !buffer_pool) {
+			return file_handle->WillNeed(file_offset + byte_start, byte_size);
+		}
+		return false;
+	}
+
+	OctreeFileReader(std::shared_ptr<ByteSource> source) : file_path(source->Name()), file_size(static_cast<size_t>(source->Size())), mode(ReaderMode::Source), byte_source(std::move(source)) {};
+
+	// View of a range of the mapped octree data, trimmed to the end of the data
+	OctreeNodeView mappedView(uint64_t byte_start, uint64_t byte_size) const
+	{
+		if (byte_start >= file_size || byte_size == 0) {
+			return OctreeNodeView();
+		}
+
+		byte_size = (std::min)(byte_start + byte_size, static_cast<uint64_t>(file_size)) - byte_start;
+		return OctreeNodeView(file_mapping->data() + file_offset + byte_start, static_cast<size_t>(byte_size), file_mapping);
+	}
+
+	// Reads many ranges of the octree data with several reads in flight, see OctreeAsyncReader and ByteSource::Read
+	void Read(std::vector<AsyncReadRequest> requests, const AsyncReadCallback& callback, const AsyncReadOptions& options = AsyncReadOptions()) const
+	{
+		if (byte_source) {
+			byte_source->Read(requests, callback, options);
+			return;
+		}
+
+		// Translate to positions in the file, without reaching into whatever follows the octree data
+		for (auto& request : requests)
+		{
+			const uint64_t start = (std::min)(request.byteOffset, static_cast<uint64_t>(file_size));
+			request.byteSize = (std::min)(request.byteSize, static_cast<uint64_t>(file_size) - start);
+			request.byteOffset = file_offset + start;
+		}
+
+		auto reader = OctreeAsyncReader(file_path, file_handle ? file_handle : std::make_shared<PositionalFile>(file_path), read_workers);
+		reader.Read(requests, callback, options);
+	}
+
+	// Reads a range bypassing the page cache. The read is expanded to aligned block boundaries
+	// into a pooled buffer and the returned view is trimmed back to the requested range
+	OctreeNodeView readDirect(uint64_t byte_start, uint64_t byte_size) const
+	{
+		if (byte_start >= file_size || byte_size == 0) {
+			return OctreeNodeView();
+		}
+
+		byte_size = (std::min)(byte_start + byte_size, static_cast<uint64_t>(file_size)) - byte_start;
+
+		// Alignment applies to positions in the file, not in the octree data
+		const uint64_t file_start = file_offset + byte_start;
+		const uint64_t aligned_start = file_start / direct_alignment * direct_alignment;
+		const uint64_t aligned_end = (file_start + byte_size + direct_alignment - 1) / direct_alignment * direct_alignment;
+
+		auto buffer = buffer_pool->Acquire(static_cast<size_t>(aligned_end - aligned_start));
+		const size_t bytes_read = file_handle->readAt(aligned_start, aligned_end - aligned_start, buffer->data());
+
+		if (!file_handle->BypassesCache()) {
+			file_handle->DropCache(aligned_start, aligned_end - aligned_start);
+		}
+
+		const size_t head = static_cast<size_t>(file_start - aligned_start);
+		const size_t available = bytes_read > head ? (std::min)(bytes_read - head, static_cast<size_t>(byte_size)) : 0;
+
+		return OctreeNodeView(buffer->data() + head, available, buffer);
+	}
 
 	inline size_t readBinaryData(FILE* file, uint64_t byte_start, uint64_t byte_size, uint8_t* target) const
 	{
@@ -19,10 +155,14 @@ struct OctreeFileReader
 		}
 
 		// Determine bytes to read
-		auto bytes_to_read = (std::min)(byte_start + byte_size, file_size) - byte_start;
+		auto bytes_to_read = (std::min)(byte_start + byte_size, static_cast<uint64_t>(file_size)) - byte_start;
 
 		// Read the data
-		_fseeki64(file, byte_start, SEEK_SET);
+#ifdef _WIN32
+		_fseeki64(file, file_offset + byte_start, SEEK_SET);
+#else
+		fseeko(file, static_cast<off_t>(file_offset + byte_start), SEEK_SET);
+#endif
 		const auto bytes_read = fread(target, sizeof(uint8_t), bytes_to_read, file);
 
 		return bytes_read;
@@ -30,26 +170,60 @@ struct OctreeFileReader
 
 	inline size_t readBinaryData(uint64_t byte_start, uint64_t byte_size, uint8_t* target) const
 	{
+		if (file_mapping)
+		{
+			auto view = mappedView(byte_start, byte_size);
+			if (!view.empty()) {
+				memcpy(target, view.data(), view.size());
+			}
+			return view.size();
+		}
+
+		if (byte_source)
+		{
+			return byte_source->ReadAt(byte_start, byte_size, target);
+		}
+
+		if (buffer_pool)
+		{
+			auto view = readDirect(byte_start, byte_size);
+			if (!view.empty()) {
+				memcpy(target, view.data(), view.size());
+			}
+			return view.size();
+		}
+
+		if (file_handle)
+		{
+			if (byte_start >= file_size) {
+				return 0;
+			}
+
+			auto bytes_to_read = (std::min)(byte_start + byte_size, static_cast<uint64_t>(file_size)) - byte_start;
+			return file_handle->readAt(file_offset + byte_start, bytes_to_read, target);
+		}
+
 		FILE* file;
+#ifdef _WIN32
 		errno_t err = fopen_s(&file, file_path.c_str(), "rb");
 		if (err != 0) {
 			return 0;
 		}
+#else
+		file = fopen(file_path.c_str(), "rb");
+		if (file == nullptr) {
+			return 0;
+		}
+#endif
 
 		auto bytes_read = readBinaryData(file, byte_start, byte_size, target);
 
-		// Determine bytes to read
-		//auto bytes_to_read = (std::min)(byte_start + byte_size, file_size) - byte_start;
-
-		//// Read the data
-		//_fseeki64(file, byte_start, SEEK_SET);
-		//const auto bytes_read = fread(target, sizeof(uint8_t), bytes_to_read, file);
 		fclose(file);
 
 		return bytes_read;
 	}
 
-	inline size_t readBinaryData(uint64_t byte_start, uint64_t byte_size, std::vector<uint8_t>& data)
+	inline size_t readBinaryData(uint64_t byte_start, uint64_t byte_size, std::vector<uint8_t>& data) const
 	{
 		// Resize the data vector if necessary
 		if (data.size() < byte_size)
@@ -60,11 +234,11 @@ struct OctreeFileReader
 		return readBinaryData(byte_start, byte_size, data.data());
 	}
 
-	static void readBinaryFile(std::string path, std::vector<uint8_t>& data, uint64_t start, uint64_t size) 
+	static void readBinaryFile(std::string path, std::vector<uint8_t>& data, uint64_t start, uint64_t size)
 	{
 		OctreeFileReader reader(path);
 		reader.readBinaryData(start, size, data);
 	}
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,454 @@
+#pragma once
+#ifndef OCTREEFRUSTUMCULLING_H
+#define OCTREEFRUSTUMCULLING_H
+#include <bit>
+#include <cmath>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <stdexcept>
+#include "../ThirdParty/PotreeConverter/Geometry.h"
+#include "OctreeNodeBounds.h" // POTREELOADER_HAS_SSE2, POTREELOADER_HAS_AVX2
+#include "OctreeTraversal.h"
+#include "OctreeRegionQuery.h"
+#include "OctreeNodeTable.h"
+
+// Plane as normal and distance, points with dot(normal, point) + distance >= 0 lie on its inner side
+struct FrustumPlane
+{
+	geometry::Vector3 normal;
+	double distance = 0.0;
+
+	double SignedDistance(double x, double y, double z) const
+	{
+		return normal.x * x + normal.y * y + normal.z * z + distance;
+	}
+};
+
+// Camera frustum as six planes with inward normals: left, right, bottom, top, near, far.
+// A region like BoxRegion, so it also works with QueryRegion and SelectPointsInRegion
+class Frustum
+{
+public:
+	FrustumPlane planes[6];
+
+	Frustum() = default;
+
+	explicit Frustum(const FrustumPlane (&planes)[6])
+	{
+		for (int i = 0; i < 6; ++i) {
+			this->planes[i] = Normalized(planes[i]);
+		}
+	}
+
+	// Planes of a column-major view projection matrix like OpenGL's. Clip space depth is -w to w,
+	// or 0 to w with zeroToOneDepth like Direct3D and Vulkan
+	static Frustum FromViewProjection(const double (&matrix)[16], bool zeroToOneDepth = false)
+	{
+		auto row = [&matrix](int i) {
+			return FrustumPlane{ geometry::Vector3(matrix[i], matrix[4 + i], matrix[8 + i]), matrix[12 + i] };
+		};
+		auto add = [](const FrustumPlane& a, const FrustumPlane& b, double sign) {
+			return FrustumPlane{ geometry::Vector3(a.normal.x + sign * b.normal.x, a.normal.y + sign * b.normal.y, a.normal.z + sign * b.normal.z), a.distance + sign * b.distance };
+		};
+
+		const FrustumPlane w = row(3);
+		const FrustumPlane planes[6] = {
+			add(w, row(0), 1), add(w, row(0), -1),
+			add(w, row(1), 1), add(w, row(1), -1),
+			zeroToOneDepth ? row(2) : add(w, row(2), 1), add(w, row(2), -1),
+		};
+		return Frustum(planes);
+	}
+
+	// Symmetric perspective frustum of a camera at position looking along direction. fovY in radians, aspect is width / height
+	static Frustum Perspective(const geometry::Vector3& position, const geometry::Vector3& direction, const geometry::Vector3& up,
+		double fovY, double aspect, double nearDistance, double farDistance)
+	{
+		const geometry::Vector3 forward = Normalized(direction);
+		const geometry::Vector3 right = Normalized(Cross(forward, up));
+		const geometry::Vector3 cameraUp = Cross(right, forward);
+
+		const double tanY = std::tan(fovY / 2);
+		const double tanX = tanY * aspect;
+
+		// A side plane contains the frustum edge direction forward -+ side * tan, its inward normal is forward * tan +- side
+		auto sidePlane = [&](const geometry::Vector3& side, double tan, double sign) {
+			const geometry::Vector3 normal(forward.x * tan + sign * side.x, forward.y * tan + sign * side.y, forward.z * tan + sign * side.z);
+			return FrustumPlane{ normal, -Dot(normal, position) };
+		};
+
+		const double forwardPosition = Dot(forward, position);
+		const FrustumPlane planes[6] = {
+			sidePlane(right, tanX, 1), sidePlane(right, tanX, -1),
+			sidePlane(cameraUp, tanY, 1), sidePlane(cameraUp, tanY, -1),
+			FrustumPlane{ forward, -(forwardPosition + nearDistance) },
+			FrustumPlane{ geometry::Vector3(-forward.x, -forward.y, -forward.z), forwardPosition + farDistance },
+		};
+		return Frustum(planes);
+	}
+
+	// A box is outside if it lies behind one plane and inside if it lies in front of all planes. Boxes near the frustum's
+	// edges may be reported as Partial although they miss it, the usual trade-off of plane tests
+	Containment Classify(const geometry::BoundingBox& box) const
+	{
+		bool partial = false;
+		for (const FrustumPlane& plane : planes)
+		{
+			// Corners farthest along and against the normal
+			const double farthest = plane.SignedDistance(
+				plane.normal.x >= 0 ? box.max.x : box.min.x, plane.normal.y >= 0 ? box.max.y : box.min.y, plane.normal.z >= 0 ? box.max.z : box.min.z);
+			if (farthest < 0) {
+				return Containment::Outside;
+			}
+
+			const double nearest = plane.SignedDistance(
+				plane.normal.x >= 0 ? box.min.x : box.max.x, plane.normal.y >= 0 ? box.min.y : box.max.y, plane.normal.z >= 0 ? box.min.z : box.max.z);
+			partial |= nearest < 0;
+		}
+		return partial ? Containment::Partial : Containment::Inside;
+	}
+
+	// Classifies count boxes of the arrays starting at first. Four boxes at a time with AVX2, two with SSE2
+	void Classify(const BoundingBoxArrays& boxes, size_t first, size_t count, Containment* containment) const
+	{
+		if (boxes.size() < first + count) {
+			throw std::out_of_range("Frustum culling range exceeds the bounding boxes");
+		}
+
+		const double* mins[3] = { boxes.minX.data() + first, boxes.minY.data() + first, boxes.minZ.data() + first };
+		const double* maxs[3] = { boxes.maxX.data() + first, boxes.maxY.data() + first, boxes.maxZ.data() + first };
+
+		// The corner coordinates each plane tests, picked once per plane from the signs of its normal
+		struct PlaneCorners
+		{
+			const double* farthest[3];
+			const double* nearest[3];
+			double normal[3];
+			double distance;
+		} corners[6];
+
+		for (int p = 0; p < 6; ++p)
+		{
+			const double normal[3] = { planes[p].normal.x, planes[p].normal.y, planes[p].normal.z };
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				corners[p].farthest[axis] = normal[axis] >= 0 ? maxs[axis] : mins[axis];
+				corners[p].nearest[axis] = normal[axis] >= 0 ? mins[axis] : maxs[axis];
+				corners[p].normal[axis] = normal[axis];
+			}
+			corners[p].distance = planes[p].distance;
+		}
+
+		size_t i = 0;
+
+#if POTREELOADER_HAS_AVX2
+		const __m256d zero4 = _mm256_setzero_pd();
+		for (; i + 4 <= count; i += 4)
+		{
+			__m256d outside = zero4;
+			__m256d partial = zero4;
+			for (const PlaneCorners& plane : corners)
+			{
+				__m256d farthest = _mm256_set1_pd(plane.distance);
+				__m256d nearest = farthest;
+				for (int axis = 0; axis < 3; ++axis)
+				{
+					const __m256d normal = _mm256_set1_pd(plane.normal[axis]);
+					farthest = _mm256_add_pd(farthest, _mm256_mul_pd(normal, _mm256_loadu_pd(plane.farthest[axis] + i)));
+					nearest = _mm256_add_pd(nearest, _mm256_mul_pd(normal, _mm256_loadu_pd(plane.nearest[axis] + i)));
+				}
+				outside = _mm256_or_pd(outside, _mm256_cmp_pd(farthest, zero4, _CMP_LT_OQ));
+				partial = _mm256_or_pd(partial, _mm256_cmp_pd(nearest, zero4, _CMP_LT_OQ));
+			}
+			Store(_mm256_movemask_pd(outside), _mm256_movemask_pd(partial), 4, containment + i);
+		}
+#endif
+#if POTREELOADER_HAS_SSE2
+		const __m128d zero2 = _mm_setzero_pd();
+		for (; i + 2 <= count; i += 2)
+		{
+			__m128d outside = zero2;
+			__m128d partial = zero2;
+			for (const PlaneCorners& plane : corners)
+			{
+				__m128d farthest = _mm_set1_pd(plane.distance);
+				__m128d nearest = farthest;
+				for (int axis = 0; axis < 3; ++axis)
+				{
+					const __m128d normal = _mm_set1_pd(plane.normal[axis]);
+					farthest = _mm_add_pd(farthest, _mm_mul_pd(normal, _mm_loadu_pd(plane.farthest[axis] + i)));
+					nearest = _mm_add_pd(nearest, _mm_mul_pd(normal, _mm_loadu_pd(plane.nearest[axis] + i)));
+				}
+				outside = _mm_or_pd(outside, _mm_cmplt_pd(farthest, zero2));
+				partial = _mm_or_pd(partial, _mm_cmplt_pd(nearest, zero2));
+			}
+			Store(_mm_movemask_pd(outside), _mm_movemask_pd(partial), 2, containment + i);
+		}
+#endif
+		for (; i < count; ++i)
+		{
+			int outside = 0;
+			int partial = 0;
+			for (const PlaneCorners& plane : corners)
+			{
+				double farthest = plane.distance;
+				double nearest = plane.distance;
+				for (int axis = 0; axis < 3; ++axis)
+				{
+					farthest += plane.normal[axis] * plane.farthest[axis][i];
+					nearest += plane.normal[axis] * plane.nearest[axis][i];
+				}
+				outside |= farthest < 0;
+				partial |= nearest < 0;
+			}
+			Store(outside, partial, 1, containment + i);
+		}
+	}
+
+	bool Contains(double x, double y, double z) const
+	{
+		for (const FrustumPlane& plane : planes)
+		{
+			if (plane.SignedDistance(x, y, z) < 0) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// inside[i] is set to 1 for the points within the frustum, 0 otherwise
+	void ContainsPoints(const double* x, const double* y, const double* z, size_t count, uint8_t* inside) const
+	{
+		for (size_t i = 0; i < count; ++i) {
+			inside[i] = Contains(x[i], y[i], z[i]) ? 1 : 0;
+		}
+	}
+
+private:
+	// Lane k of the comparison masks to the containment of box k
+	static void Store(int outside, int partial, int lanes, Containment* containment)
+	{
+		for (int k = 0; k < lanes; ++k) {
+			containment[k] = (outside >> k) & 1 ? Containment::Outside : (partial >> k) & 1 ? Containment::Partial : Containment::Inside;
+		}
+	}
+
+	static double Dot(const geometry::Vector3& a, const geometry::Vector3& b)
+	{
+		return a.x * b.x + a.y * b.y + a.z * b.z;
+	}
+
+	static geometry::Vector3 Cross(const geometry::Vector3& a, const geometry::Vector3& b)
+	{
+		return geometry::Vector3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+	}
+
+	static geometry::Vector3 Normalized(const geometry::Vector3& v)
+	{
+		const double length = std::sqrt(Dot(v, v));
+		if (!(length > 0)) {
+			throw std::invalid_argument("Frustum directions and plane normals cannot be zero");
+		}
+		return geometry::Vector3(v.x / length, v.y / length, v.z / length);
+	}
+
+	// Scaled to a unit normal, so signed distances are distances
+	static FrustumPlane Normalized(const FrustumPlane& plane)
+	{
+		const double length = std::sqrt(Dot(plane.normal, plane.normal));
+		if (!(length > 0)) {
+			throw std::invalid_argument("Frustum directions and plane normals cannot be zero");
+		}
+		return { geometry::Vector3(plane.normal.x / length, plane.normal.y / length, plane.normal.z / length), plane.distance / length };
+	}
+};
+
+// Nodes which survived culling, level by level. inside[i] is 1 if the box of nodes[i] lies completely within the frustum,
+// so its points need no further test
+template<typename Node>
+struct FrustumCullResult
+{
+	std::vector<Node> nodes;
+	std::vector<uint8_t> inside;
+
+	size_t size() const
+	{
+		return nodes.size();
+	}
+
+	void clear()
+	{
+		nodes.clear();
+		inside.clear();
+	}
+};
+
+// Level by level culling shared by the cullers below. The boxes of a level's undecided nodes are gathered into
+// coordinate arrays and classified in one batch. Children of outside nodes are never collected, children of
+// inside nodes are inside without a test. Keep a culler per view, it reuses its buffers from frame to frame
+template<typename Node>
+class BasicFrustumCuller
+{
+protected:
+	std::vector<Node> undecided, next_undecided;
+	std::vector<Node> inside, next_inside;
+	std::vector<Containment> containment;
+	BoundingBoxArrays boxes;
+
+	// gatherBoxes(nodes, boxes) fills the first nodes.size() boxes. acceptNode(node, children) is called for every node which
+	// is not outside, children is null at levels.maxLevel and the vector the node's children are appended to otherwise
+	template<typename GatherBoxes, typename AcceptNode>
+	void CullLevels(const Node& root, int rootLevel, const Frustum& frustum, FrustumCullResult<Node>& result, const LevelRange& levels,
+		GatherBoxes&& gatherBoxes, AcceptNode&& acceptNode)
+	{
+		result.clear();
+		undecided.assign(1, root);
+		inside.clear();
+
+		for (int level = rootLevel; level <= levels.maxLevel && !(undecided.empty() && inside.empty()); ++level)
+		{
+			const bool report = level >= levels.minLevel;
+			const bool descend = level < levels.maxLevel;
+			next_undecided.clear();
+			next_inside.clear();
+
+			if (boxes.size() < undecided.size()) {
+				boxes.resize(undecided.size());
+			}
+			containment.resize(undecided.size());
+			gatherBoxes(undecided, boxes);
+			frustum.Classify(boxes, 0, undecided.size(), containment.data());
+
+			for (size_t i = 0; i < undecided.size(); ++i)
+			{
+				if (containment[i] == Containment::Outside) {
+					continue;
+				}
+
+				const bool nodeInside = containment[i] == Containment::Inside;
+				if (report)
+				{
+					result.nodes.push_back(undecided[i]);
+					result.inside.push_back(nodeInside ? 1 : 0);
+				}
+				acceptNode(undecided[i], descend ? (nodeInside ? &next_inside : &next_undecided) : nullptr);
+			}
+
+			for (const Node& node : inside)
+			{
+				if (report)
+				{
+					result.nodes.push_back(node);
+					result.inside.push_back(1);
+				}
+				acceptNode(node, descend ? &next_inside : nullptr);
+			}
+
+			undecided.swap(next_undecided);
+			inside.swap(next_inside);
+		}
+	}
+};
+
+// Culls any node type the traversals handle, e.g. OctreeGeometryNode* or HierarchyViewNode.
+// Boxes come from the node keys, so nodes of a lazy hierarchy are only expanded once they turn out not to be outside
+// and culled proxies load no chunks
+template<typename Node>
+class FrustumCuller : public BasicFrustumCuller<Node>
+{
+public:
+	void Cull(const Node& root, const Frustum& frustum, FrustumCullResult<Node>& result, const LevelRange& levels = LevelRange())
+	{
+		using Traits = OctreeTraversalTraits<Node>;
+
+		this->CullLevels(root, Traits::Level(root), frustum, result, levels,
+			[](const std::vector<Node>& nodes, BoundingBoxArrays& boxes) {
+				for (size_t i = 0; i < nodes.size(); ++i)
+				{
+					const geometry::BoundingBox box = octree_region::Bounds(nodes[i]);
+					boxes.minX[i] = box.min.x;
+					boxes.minY[i] = box.min.y;
+					boxes.minZ[i] = box.min.z;
+					boxes.maxX[i] = box.max.x;
+					boxes.maxY[i] = box.max.y;
+					boxes.maxZ[i] = box.max.z;
+				}
+			},
+			[](const Node& node, std::vector<Node>* nodes) {
+				Traits::Prepare(node);
+				if (nodes != nullptr)
+				{
+					Node children[8];
+					const int count = Traits::Children(node, children);
+					nodes->insert(nodes->end(), children, children + count);
+				}
+			});
+	}
+
+	FrustumCullResult<Node> Cull(const Node& root, const Frustum& frustum, const LevelRange& levels = LevelRange())
+	{
+		FrustumCullResult<Node> result;
+		Cull(root, frustum, result, levels);
+		return result;
+	}
+};
+
+// Culls an OctreeNodeTable and reports table indices. The boxes of all nodes are computed once when the culler is created,
+// afterwards a level's boxes are gathered from them and the children of a node are the index range after its firstChild
+class TableFrustumCuller : public BasicFrustumCuller<uint32_t>
+{
+	const OctreeNodeTable* node_table;
+	BoundingBoxArrays table_boxes;
+
+public:
+	// The table has to outlive the culler and must not change while it is used
+	explicit TableFrustumCuller(const OctreeNodeTable& table) : node_table(&table)
+	{
+		table.BoundingBoxes(table_boxes);
+	}
+
+	void Cull(const Frustum& frustum, FrustumCullResult<uint32_t>& result, const LevelRange& levels = LevelRange())
+	{
+		if (node_table->size() == 0)
+		{
+			result.clear();
+			return;
+		}
+
+		const OctreeNodeTable& table = *node_table;
+		const BoundingBoxArrays& all = table_boxes;
+		CullLevels(0, table.level[0], frustum, result, levels,
+			[&all](const std::vector<uint32_t>& nodes, BoundingBoxArrays& boxes) {
+				for (size_t i = 0; i < nodes.size(); ++i)
+				{
+					const uint32_t node = nodes[i];
+					boxes.minX[i] = all.minX[node];
+					boxes.minY[i] = all.minY[node];
+					boxes.minZ[i] = all.minZ[node];
+					boxes.maxX[i] = all.maxX[node];
+					boxes.maxY[i] = all.maxY[node];
+					boxes.maxZ[i] = all.maxZ[node];
+				}
+			},
+			[&table](uint32_t node, std::vector<uint32_t>* nodes) {
+				if (nodes == nullptr) {
+					return;
+				}
+				const uint32_t first = table.firstChild[node];
+				const uint32_t count = static_cast<uint32_t>(std::popcount(table.childMask[node]));
+				for (uint32_t child = first; child < first + count; ++child) {
+					nodes->push_back(child);
+				}
+			});
+	}
+
+	FrustumCullResult<uint32_t> Cull(const Frustum& frustum, const LevelRange& levels = LevelRange())
+	{
+		FrustumCullResult<uint32_t> result;
+		Cull(frustum, result, levels);
+		return result;
+	}
+};
+
+#endif
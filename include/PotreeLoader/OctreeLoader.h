@@ -1,8 +1,13 @@
 #pragma once
 #ifndef OCTREELOADER_H
 #define OCTREELOADER_H
+#include <future>
 #include "OctreeData.h"
 #include "OctreeFileReader.h"
+#include "OctreeAsyncReader.h"
+#include "OctreeReadPlanner.h"
+#include "OctreePrefetcher.h"
+#include "OctreeRayPick.h"
 
 class OctreeLoader
 {
@@ -11,6 +16,7 @@ private:
 	Octree* pOctree;
 	OctreeFileReader OctreeReader;
 	int64_t max_node_bytes;
+	std::shared_ptr<OctreePrefetcher> prefetcher;
 
 
 public:
@@ -61,54 +67,502 @@ private:
 		return offsets;
 	}
 
+	static OctreeFileReader CreateReader(Octree* octree, ReaderMode readerMode)
+	{
+		if (octree->octreeSource) {
+			return OctreeFileReader(octree->octreeSource);
+		}
+
+		if (octree->files.octreeEmbedded) {
+			return OctreeFileReader(octree->files.octree, readerMode, octree->files.octreeOffset, octree->files.octreeSize);
+		}
+
+		return OctreeFileReader(octree->files.octree, readerMode);
+	}
+
 	size_t GetMaxNodeSize()
 	{
+		// Only nodes which are already loaded, so a lazy hierarchy is not expanded here. Buffers grow for larger nodes
 		int64_t buffer_size = 0;
-		pOctree->geometry.root->traverse([&buffer_size](OctreeGeometryNode* node, int level) {
-			buffer_size = (std::max)(buffer_size, node->byteSize);
-			});
+		if (const auto& table = pOctree->geometry.nodeTable) {
+			for (const uint32_t size : table->byteSize) {
+				buffer_size = (std::max)(buffer_size, static_cast<int64_t>(size));
+			}
+		}
 
-		return static_cast<size_t>((std::max)(buffer_size, 0ll));
+		for (const auto& node : pOctree->geometry.nodes)
+		{
+			// A pending proxy holds the byte range of its hierarchy chunk until it is expanded
+			if (!node->pendingChunk.load(std::memory_order_acquire)) {
+				buffer_size = (std::max)(buffer_size, node->byteSize);
+			}
+		}
+
+		return static_cast<size_t>((std::max)(buffer_size, int64_t(0)));
+	}
+
+public:
+	// ReaderMode::Persistent opens octree.bin once and serves all LoadNodeData calls with positional reads.
+	// ReaderMode::MemoryMapped maps octree.bin and additionally allows zero-copy access with LoadNodeView.
+	// ReaderMode::Direct bypasses the page cache for one-off scans, LoadNodeView then points into a pooled aligned buffer.
+	// In all of these modes LoadNodeData may be called from several threads at once, as long as every thread uses its own buffer
+	// Octrees loaded with LoadFromByteSources are always read through their octreeSource, the reader mode is ignored then
+	OctreeLoader(std::shared_ptr<Octree>& octree, ReaderMode readerMode = ReaderMode::Persistent) : 
+		octree(octree), pOctree(this->octree.get()), pcloud_byte_offsets(SetAttributeByteOffsets()), OctreeReader(CreateReader(pOctree, readerMode)), max_node_bytes(GetMaxNodeSize()) {};
+
+	OctreeLoader(Octree* octreePtr, ReaderMode readerMode = ReaderMode::Persistent) : 
+		octree(nullptr), pOctree(octreePtr), pcloud_byte_offsets(SetAttributeByteOffsets()), OctreeReader(CreateReader(pOctree, readerMode)), max_node_bytes(GetMaxNodeSize()) {};
+
+	// Reads node data from any byte source, e.g. MemoryByteSource or HttpByteSource
+	OctreeLoader(Octree* octreePtr, std::shared_ptr<ByteSource> octreeSource) : 
+		octree(nullptr), pOctree(octreePtr), pcloud_byte_offsets(SetAttributeByteOffsets()), OctreeReader(std::move(octreeSource)), max_node_bytes(GetMaxNodeSize()) {};
+
+private:
+	void Prefetch(const OctreeGeometryNode* node) const
+	{
+		if (prefetcher) {
+			prefetcher->OnNodeLoad(node, [this](uint64_t byteOffset, uint64_t byteSize) {
+				OctreeReader.willNeed(byteOffset, byteSize);
+				});
+		}
 	}
 
 public:
-	OctreeLoader(std::shared_ptr<Octree>& octree) : 
-		octree(octree), pOctree(this->octree.get()), pcloud_byte_offsets(SetAttributeByteOffsets()), OctreeReader(pOctree->files.octree), max_node_bytes(GetMaxNodeSize()) {};
+	// Loading a node hints the OS to read its children (and deeper levels, depending on the policy) in the background.
+	// Hints are only supported for the persistent reader on POSIX systems and the memory mapped reader, otherwise this does nothing
+	void SetPrefetchPolicy(const PrefetchPolicy& policy)
+	{
+		if (!policy.enabled || !OctreeReader.supportsHints()) {
+			prefetcher.reset();
+			return;
+		}
 
-	OctreeLoader(Octree* octreePtr) : 
-		octree(nullptr), pOctree(octreePtr), pcloud_byte_offsets(SetAttributeByteOffsets()), OctreeReader(pOctree->files.octree), max_node_bytes(GetMaxNodeSize()) {};
+		prefetcher = std::make_shared<OctreePrefetcher>(policy);
+	}
 
+	PrefetchStats GetPrefetchStats() const
+	{
+		return prefetcher ? prefetcher->Stats() : PrefetchStats();
+	}
 
 	std::vector<uint8_t> CreateMaxNodeBuffer() const
 	{
 		std::vector<uint8_t> buffer;
-		int64_t buffer_size = static_cast<size_t>((std::max)(max_node_bytes, 0ll));
+		int64_t buffer_size = static_cast<size_t>((std::max)(max_node_bytes, int64_t(0)));
 		buffer.resize(buffer_size);
 		return buffer;
 	}
 
 	OctreeData CreateMaxNodeData() const
 	{
-		OctreeData RawNodeData((std::max)(max_node_bytes, 0ll));
+		OctreeData RawNodeData((std::max)(max_node_bytes, int64_t(0)));
 		return RawNodeData;
 	}
 
+	// Pending proxies of a lazy hierarchy are expanded first, until then their byte range points into hierarchy.bin
 	OctreeData& LoadNodeData(OctreeGeometryNode* node, OctreeData& RawNodeData)
 	{
+		node->expand();
+		Prefetch(node);
 		RawNodeData.Extend(node->byteSize);
 		OctreeReader.readBinaryData(node->byteOffset, node->byteSize, RawNodeData.data_raw);
 		return RawNodeData;
 	}
 
+	// Node handles which only know their byte range, i.e. OctreeTableNode (HierarchyLoading::Table) and HierarchyViewNode
+	template<typename NodeHandle> requires requires(const NodeHandle& node) { node.byteOffset(); node.byteSize(); }
+	OctreeData& LoadNodeData(const NodeHandle& node, OctreeData& RawNodeData) const
+	{
+		RawNodeData.Extend(static_cast<size_t>(node.byteSize()));
+		OctreeReader.readBinaryData(node.byteOffset(), node.byteSize(), RawNodeData.data_raw);
+		return RawNodeData;
+	}
+
+	template<typename NodeHandle> requires requires(const NodeHandle& node) { node.byteOffset(); node.byteSize(); }
+	OctreeNodeView LoadNodeView(const NodeHandle& node) const
+	{
+		if (OctreeReader.file_mapping) {
+			return OctreeReader.mappedView(node.byteOffset(), node.byteSize());
+		}
+
+		if (OctreeReader.buffer_pool) {
+			return OctreeReader.readDirect(node.byteOffset(), node.byteSize());
+		}
+
+		auto buffer = std::make_shared<std::vector<uint8_t>>(static_cast<size_t>(node.byteSize()));
+		auto bytes_read = OctreeReader.readBinaryData(node.byteOffset(), node.byteSize(), buffer->data());
+		return OctreeNodeView(buffer->data(), bytes_read, buffer);
+	}
+
 	OctreeData LoadNodeData(OctreeGeometryNode* node)
 	{
+		node->expand();
 		OctreeData RawNodeData(node->byteSize);
 		LoadNodeData(node, RawNodeData);
 		return RawNodeData;
 	}
 
+	// Returns a view of the node's bytes without copying them when the loader uses ReaderMode::MemoryMapped.
+	// In the other modes the bytes are read into a new buffer which is owned by the view
+	OctreeNodeView LoadNodeView(OctreeGeometryNode* node) const
+	{
+		node->expand();
+		if (node->byteSize <= 0) {
+			return OctreeNodeView();
+		}
+
+		Prefetch(node);
+
+		if (OctreeReader.file_mapping) {
+			return OctreeReader.mappedView(node->byteOffset, node->byteSize);
+		}
+
+		if (OctreeReader.buffer_pool) {
+			return OctreeReader.readDirect(node->byteOffset, node->byteSize);
+		}
+
+		if (auto& source = OctreeReader.byte_source; source && source->Data() != nullptr)
+		{
+			uint64_t start = (std::min)(static_cast<uint64_t>(node->byteOffset), source->Size());
+			uint64_t size = (std::min)(static_cast<uint64_t>(node->byteSize), source->Size() - start);
+			return OctreeNodeView(source->Data() + start, static_cast<size_t>(size), source);
+		}
+
+		auto buffer = std::make_shared<std::vector<uint8_t>>(node->byteSize);
+		auto bytes_read = OctreeReader.readBinaryData(node->byteOffset, node->byteSize, buffer->data());
+		return OctreeNodeView(buffer->data(), bytes_read, buffer);
+	}
+
+	// Appends the indices of the node's points which lie within the region, node data as loaded by LoadNodeData or LoadNodeView.
+	// containment is the node's classification from a region query: Inside selects all points and Outside none without
+	// decoding a position, only Partial nodes are tested point by point. Returns the number of selected points
+	template<typename Region>
+	size_t SelectPointsInRegion(const Region& region, const uint8_t* data, size_t byteSize, Containment containment, std::vector<uint32_t>& indices) const
+	{
+		const size_t bytesPerPoint = static_cast<size_t>(pOctree->geometry.pointAttributes.bytes);
+		const size_t pointCount = bytesPerPoint > 0 ? byteSize / bytesPerPoint : 0;
+
+		if (containment == Containment::Outside) {
+			return 0;
+		}
+
+		if (containment == Containment::Inside)
+		{
+			const size_t first = indices.size();
+			indices.resize(first + pointCount);
+			for (size_t i = 0; i < pointCount; ++i) {
+				indices[first + i] = static_cast<uint32_t>(i);
+			}
+			return pointCount;
+		}
+
+		if (pcloud_byte_offsets.xyz < 0) {
+			throw std::runtime_error("Point cloud has no position attribute");
+		}
+
+		const auto& attributes = pOctree->geometry.pointAttributes;
+		return ::SelectPointsInRegion(region, data, pointCount, bytesPerPoint, static_cast<size_t>(pcloud_byte_offsets.xyz),
+			attributes.posScale, attributes.posOffset, indices);
+	}
+
+	// Loads a batch of nodes with several reads in flight at once (io_uring on Linux, a thread pool of positional reads otherwise).
+	// The callback is invoked once per node in completion order and never concurrently. The data pointer is only valid during the call
+	void LoadNodeBatch(const std::vector<OctreeGeometryNode*>& nodes, const std::function<void(OctreeGeometryNode*, const uint8_t*, size_t)>& callback, const AsyncReadOptions& options = AsyncReadOptions()) const
+	{
+		for (auto* node : nodes) {
+			node->expand();
+		}
+
+		// Unbuffered reads need aligned ranges, so they are issued one after another from the buffer pool
+		if (OctreeReader.file_mapping || OctreeReader.buffer_pool)
+		{
+			for (auto* node : nodes) {
+				auto view = LoadNodeView(node);
+				callback(node, view.data(), view.size());
+			}
+			return;
+		}
+
+		std::vector<AsyncReadRequest> requests;
+		requests.reserve(nodes.size());
+		for (size_t i = 0; i < nodes.size(); ++i) {
+			requests.push_back({ static_cast<uint64_t>(nodes[i]->byteOffset), static_cast<uint64_t>((std::max)(nodes[i]->byteSize, int64_t(0))), i });
+		}
+
+		OctreeReader.Read(std::move(requests), [&nodes, &callback](size_t id, const uint8_t* data, size_t size) {
+			callback(nodes[id], data, size);
+			}, options);
+	}
+
+	// Sorts the nodes by byteOffset and merges neighbouring byte ranges into larger reads
+	ReadPlan PlanNodeReads(const std::vector<OctreeGeometryNode*>& nodes, const ReadPlanOptions& planOptions = ReadPlanOptions()) const
+	{
+		std::vector<AsyncReadRequest> ranges;
+		ranges.reserve(nodes.size());
+		for (size_t i = 0; i < nodes.size(); ++i) {
+			nodes[i]->expand();
+			ranges.push_back({ static_cast<uint64_t>(nodes[i]->byteOffset), static_cast<uint64_t>((std::max)(nodes[i]->byteSize, int64_t(0))), i });
+		}
+
+		return ReadPlan::Create(std::move(ranges), planOptions);
+	}
+
+	// Like LoadNodeBatch, but neighbouring nodes are loaded with one merged read. Each node gets a pointer to its
+	// slice of the merged buffer, no extra copy is made. Returns bytes read vs. bytes used to tune the plan options
+	ReadPlanStats LoadNodesCoalesced(const std::vector<OctreeGeometryNode*>& nodes, const std::function<void(OctreeGeometryNode*, const uint8_t*, size_t)>& callback,
+		const ReadPlanOptions& planOptions = ReadPlanOptions(), const AsyncReadOptions& options = AsyncReadOptions()) const
+	{
+		auto plan = PlanNodeReads(nodes, planOptions);
+
+		if (OctreeReader.file_mapping)
+		{
+			// The page cache does the merging, just walk the nodes in file order
+			for (const auto& slice : plan.slices) {
+				auto view = LoadNodeView(nodes[slice.id]);
+				callback(nodes[slice.id], view.data(), view.size());
+			}
+			return plan.stats;
+		}
+
+		if (OctreeReader.buffer_pool)
+		{
+			for (const auto& read : plan.reads)
+			{
+				auto block = OctreeReader.readDirect(read.byteOffset, read.byteSize);
+				for (size_t i = read.firstSlice; i < read.firstSlice + read.sliceCount; ++i)
+				{
+					const auto& slice = plan.slices[i];
+					const size_t start = static_cast<size_t>((std::min)(slice.offsetInRead, static_cast<uint64_t>(block.size())));
+					const size_t size = static_cast<size_t>((std::min)(slice.byteSize, static_cast<uint64_t>(block.size() - start)));
+					callback(nodes[slice.id], block.data() + start, size);
+				}
+			}
+			return plan.stats;
+		}
+
+		auto deliver = [&nodes, &callback](size_t id, const uint8_t* data, size_t size) {
+			callback(nodes[id], data, size);
+		};
+
+		plan.Execute(OctreeReader, deliver, options);
+
+		return plan.stats;
+	}
+
+	// Reads the octree data front to back in large chunks and calls the callback per node in file order, so a full extraction
+	// streams through the file instead of seeking for every node. The next chunk is read while the callback works on the current one.
+	// Nodes are never split between chunks. The data pointer is only valid during the call
+	ReadPlanStats ScanNodes(const std::vector<OctreeGeometryNode*>& nodes, const std::function<void(OctreeGeometryNode*, const uint8_t*, size_t)>& callback,
+		const ScanOptions& scanOptions = ScanOptions()) const
+	{
+		// Chunks cover everything between the nodes, so the disk only ever sees sequential reads
+		ReadPlanOptions planOptions;
+		planOptions.maxGap = scanOptions.chunkSize;
+		planOptions.maxReadSize = scanOptions.chunkSize;
+		auto plan = PlanNodeReads(nodes, planOptions);
+
+		std::shared_ptr<std::vector<uint8_t>> buffers[2] = { std::make_shared<std::vector<uint8_t>>(), std::make_shared<std::vector<uint8_t>>() };
+
+		auto readChunk = [this, &plan, &buffers](size_t readIndex) -> OctreeNodeView {
+			const auto& read = plan.reads[readIndex];
+
+			if (OctreeReader.file_mapping) {
+				return OctreeReader.mappedView(read.byteOffset, read.byteSize);
+			}
+			if (OctreeReader.buffer_pool) {
+				return OctreeReader.readDirect(read.byteOffset, read.byteSize);
+			}
+
+			auto& buffer = buffers[readIndex % 2];
+			const size_t bytes_read = OctreeReader.readBinaryData(read.byteOffset, read.byteSize, *buffer);
+			return OctreeNodeView(buffer->data(), bytes_read, buffer);
+		};
+
+		// Mapped chunks need no reading thread, hinting the next chunk is enough
+		const bool mapped = OctreeReader.file_mapping != nullptr;
+		std::future<OctreeNodeView> next;
+		if (!plan.reads.empty()) {
+			next = std::async(mapped ? std::launch::deferred : std::launch::async, readChunk, 0);
+		}
+
+		for (size_t i = 0; i < plan.reads.size(); ++i)
+		{
+			auto chunk = next.get();
+
+			if (i + 1 < plan.reads.size())
+			{
+				if (mapped) {
+					OctreeReader.willNeed(plan.reads[i + 1].byteOffset, plan.reads[i + 1].byteSize);
+				}
+				next = std::async(mapped ? std::launch::deferred : std::launch::async, readChunk, i + 1);
+			}
+
+			const auto& read = plan.reads[i];
+			for (size_t s = read.firstSlice; s < read.firstSlice + read.sliceCount; ++s)
+			{
+				const auto& slice = plan.slices[s];
+				const size_t start = static_cast<size_t>((std::min)(slice.offsetInRead, static_cast<uint64_t>(chunk.size())));
+				const size_t size = static_cast<size_t>((std::min)(slice.byteSize, static_cast<uint64_t>(chunk.size() - start)));
+				callback(nodes[slice.id], chunk.data() + start, size);
+			}
+		}
+
+		return plan.stats;
+	}
+
+	// Scans all nodes of the octree, see ScanNodes
+	ReadPlanStats ScanAllNodes(const std::function<void(OctreeGeometryNode*, const uint8_t*, size_t)>& callback, const ScanOptions& scanOptions = ScanOptions()) const
+	{
+		return ScanNodes(pOctree->TraversableNodeReferences(), callback, scanOptions);
+	}
+
+	// Loads the points at targetSpacing: only the nodes down to the level reaching the spacing are read, with merged reads
+	// like LoadNodesCoalesced. So the bytes read follow the requested resolution instead of the depth of the tree
+	ReadPlanStats LoadNodesAtSpacing(double targetSpacing, const std::function<void(OctreeGeometryNode*, const uint8_t*, size_t)>& callback,
+		const ReadPlanOptions& planOptions = ReadPlanOptions(), const AsyncReadOptions& options = AsyncReadOptions()) const
+	{
+		return LoadNodesCoalesced(pOctree->SelectNodesForSpacing(targetSpacing), callback, planOptions, options);
+	}
+
+	// Like above within a region. callback(node, data, size, indices) receives the indices of the node's points within the region,
+	// nodes without any are skipped. Only nodes partially within the region have their points tested
+	template<typename Region>
+	ReadPlanStats LoadRegionAtSpacing(const Region& region, double targetSpacing,
+		const std::function<void(OctreeGeometryNode*, const uint8_t*, size_t, const std::vector<uint32_t>&)>& callback,
+		const ReadPlanOptions& planOptions = ReadPlanOptions(), const AsyncReadOptions& options = AsyncReadOptions()) const
+	{
+		const auto selected = pOctree->SelectNodesForSpacing(region, targetSpacing);
+
+		std::vector<OctreeGeometryNode*> nodes;
+		std::unordered_map<const OctreeGeometryNode*, Containment> containment;
+		nodes.reserve(selected.size());
+		containment.reserve(selected.size());
+		for (const auto& entry : selected)
+		{
+			nodes.push_back(entry.node);
+			containment.emplace(entry.node, entry.containment);
+		}
+
+		std::vector<uint32_t> indices;
+		return LoadNodesCoalesced(nodes, [&](OctreeGeometryNode* node, const uint8_t* data, size_t size) {
+			indices.clear();
+			if (SelectPointsInRegion(region, data, size, containment.at(node), indices) > 0) {
+				callback(node, data, size, indices);
+			}
+		}, planOptions, options);
+	}
+
+	// Picks the point which comes first along the ray among the points within options.radius of it. Nodes are visited front to back
+	// by the distance at which the ray enters their box grown by the radius, and only those are loaded. Once that distance exceeds
+	// the best hit no closer point can follow, so picking stops. Works with geometry nodes and node handles like OctreeTableNode
+	template<typename Node>
+	PickResult<Node> PickPoint(const Node& root, const Ray& ray, const PickOptions& options = PickOptions()) const
+	{
+		using Traits = OctreeTraversalTraits<Node>;
+
+		if (!(options.radius >= 0)) {
+			throw std::invalid_argument("Pick radius cannot be negative");
+		}
+		if (pcloud_byte_offsets.xyz < 0) {
+			throw std::runtime_error("Point cloud has no position attribute");
+		}
+
+		struct Candidate
+		{
+			double entry;
+			Node node;
+			int level;
+
+			bool operator>(const Candidate& rhs) const
+			{
+				return entry > rhs.entry;
+			}
+		};
+
+		std::vector<Candidate> candidates;
+		auto push = [&](const Node& node, int level) {
+			geometry::BoundingBox box = octree_region::Bounds(node);
+			box.min = geometry::Vector3(box.min.x - options.radius, box.min.y - options.radius, box.min.z - options.radius);
+			box.max = geometry::Vector3(box.max.x + options.radius, box.max.y + options.radius, box.max.z + options.radius);
+
+			double entry, exit;
+			if (level <= options.maxLevel && IntersectRay(ray, box, entry, exit) && entry <= options.maxDistance)
+			{
+				candidates.push_back({ entry, node, level });
+				std::push_heap(candidates.begin(), candidates.end(), std::greater<Candidate>());
+			}
+		};
+
+		const auto& attributes = pOctree->geometry.pointAttributes;
+		const size_t bytesPerPoint = static_cast<size_t>(attributes.bytes);
+		const size_t positionOffset = static_cast<size_t>(pcloud_byte_offsets.xyz);
+		const double radiusSquared = options.radius * options.radius;
+
+		PickResult<Node> result;
+		push(root, Traits::Level(root));
+
+		Node children[8];
+		while (!candidates.empty())
+		{
+			std::pop_heap(candidates.begin(), candidates.end(), std::greater<Candidate>());
+			const Candidate candidate = candidates.back();
+			candidates.pop_back();
+
+			if (candidate.entry > result.distance) {
+				break;
+			}
+
+			Traits::Prepare(candidate.node);
+
+			const OctreeNodeView view = LoadNodeView(candidate.node);
+			++result.nodesLoaded;
+
+			const size_t pointCount = bytesPerPoint > 0 ? view.size() / bytesPerPoint : 0;
+			for (size_t i = 0; i < pointCount; ++i)
+			{
+				int32_t position[3];
+				memcpy(position, view.data() + i * bytesPerPoint + positionOffset, sizeof(position));
+				const double dx = position[0] * attributes.posScale.x + attributes.posOffset.x - ray.origin.x;
+				const double dy = position[1] * attributes.posScale.y + attributes.posOffset.y - ray.origin.y;
+				const double dz = position[2] * attributes.posScale.z + attributes.posOffset.z - ray.origin.z;
+
+				const double distance = dx * ray.direction.x + dy * ray.direction.y + dz * ray.direction.z;
+				if (distance < 0 || distance > options.maxDistance || distance >= result.distance) {
+					continue;
+				}
+
+				const double squaredToRay = (std::max)(dx * dx + dy * dy + dz * dz - distance * distance, 0.0);
+				if (squaredToRay <= radiusSquared)
+				{
+					result.node = candidate.node;
+					result.pointIndex = static_cast<uint32_t>(i);
+					result.position = geometry::Vector3(dx + ray.origin.x, dy + ray.origin.y, dz + ray.origin.z);
+					result.distance = distance;
+					result.distanceToRay = std::sqrt(squaredToRay);
+				}
+			}
+
+			const int count = Traits::Children(candidate.node, children);
+			for (int n = 0; n < count; ++n) {
+				push(children[n], candidate.level + 1);
+			}
+		}
+
+		return result;
+	}
+
+	PickResult<OctreeGeometryNode*> PickPoint(const Ray& ray, const PickOptions& options = PickOptions()) const
+	{
+		if (pOctree == nullptr || !pOctree->geometry.root) {
+			return PickResult<OctreeGeometryNode*>();
+		}
+		return PickPoint(pOctree->geometry.root.get(), ray, options);
+	}
+
 	int64_t LoadNodeData(OctreeGeometryNode* node, std::vector<uint8_t>& buffer)
 	{
+		node->expand();
+		Prefetch(node);
 		buffer.resize(node->byteSize);
 		OctreeReader.readBinaryData(node->byteOffset, node->byteSize, buffer);
 		return static_cast<int64_t>(buffer.size());
@@ -0,0 +1,179 @@
+#pragma once
+#ifndef OCTREELODSELECTION_H
+#define OCTREELODSELECTION_H
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <optional>
+#include <cstdint>
+#include <algorithm>
+#include "../ThirdParty/PotreeConverter/Geometry.h"
+#include "OctreeTraversal.h"
+#include "OctreeRegionQuery.h"
+#include "OctreeFrustumCulling.h"
+
+// The view a level of detail is selected for
+struct LodCamera
+{
+	geometry::Vector3 position;
+	double fovY = 1.0;              // Vertical field of view in radians
+	double viewportHeight = 1080.0; // Pixels
+	double orthographicHeight = 0;  // World height of an orthographic view, 0 for a perspective view
+	std::optional<Frustum> frustum; // Nodes outside of it are not selected
+};
+
+struct LodOptions
+{
+	uint64_t pointBudget = 1000000;
+	double minNodePixelSize = 150.0; // Nodes whose bounding sphere projects to a smaller radius are not selected, like Potree's minimumNodePixelSize
+	int maxLevel = (std::numeric_limits<int>::max)();
+};
+
+// Nodes of a level of detail cut in selection order, every node after its parent
+template<typename Node>
+struct LodSelection
+{
+	std::vector<Node> nodes;
+	uint64_t numPoints = 0;
+	bool budgetReached = false; // Selection ended because the next node did not fit into the point budget
+
+	size_t size() const
+	{
+		return nodes.size();
+	}
+
+	void clear()
+	{
+		nodes.clear();
+		numPoints = 0;
+		budgetReached = false;
+	}
+};
+
+namespace octree_lod
+{
+	template<typename Node>
+	uint64_t NumPoints(const Node& node)
+	{
+		if constexpr (requires { node->numPoints; }) {
+			return static_cast<uint64_t>(node->numPoints);
+		}
+		else {
+			return static_cast<uint64_t>(node.numPoints());
+		}
+	}
+}
+
+// Selects nodes like Potree's renderer: starting at the root, the candidate whose bounding sphere covers the most pixels
+// is selected next and its children become candidates, until the next node would exceed the point budget.
+// Only the hierarchy is read, no point data. A lazy hierarchy loads the chunks of selected nodes only.
+// Keep a selector per view, it reuses its candidate queue from frame to frame
+template<typename Node>
+class LodSelector
+{
+	struct Candidate
+	{
+		double weight;
+		Node node;
+		int level;
+
+		bool operator<(const Candidate& rhs) const
+		{
+			return weight < rhs.weight;
+		}
+	};
+
+	std::vector<Candidate> candidates;
+
+public:
+	// Projected radius of the node's bounding sphere in pixels, the largest value if the camera is within the sphere.
+	// Negative if the node is culled by the frustum or too small
+	static double Weight(const geometry::BoundingBox& box, const LodCamera& camera, const LodOptions& options)
+	{
+		if (camera.frustum && camera.frustum->Classify(box) == Containment::Outside) {
+			return -1.0;
+		}
+
+		const double centerX = (box.min.x + box.max.x) / 2;
+		const double centerY = (box.min.y + box.max.y) / 2;
+		const double centerZ = (box.min.z + box.max.z) / 2;
+		const double sizeX = box.max.x - box.min.x;
+		const double sizeY = box.max.y - box.min.y;
+		const double sizeZ = box.max.z - box.min.z;
+		const double radius = std::sqrt(sizeX * sizeX + sizeY * sizeY + sizeZ * sizeZ) / 2;
+
+		const double dx = centerX - camera.position.x;
+		const double dy = centerY - camera.position.y;
+		const double dz = centerZ - camera.position.z;
+		const double distance = std::sqrt(dx * dx + dy * dy + dz * dz);
+
+		if (camera.orthographicHeight <= 0 && distance < radius) {
+			return (std::numeric_limits<double>::max)();
+		}
+
+		const double pixelsPerUnit = camera.orthographicHeight > 0
+			? camera.viewportHeight / camera.orthographicHeight
+			: camera.viewportHeight / 2 / (std::tan(camera.fovY / 2) * distance);
+		const double pixelRadius = radius * pixelsPerUnit;
+
+		return pixelRadius < options.minNodePixelSize ? -1.0 : pixelRadius;
+	}
+
+	void Select(const Node& root, const LodCamera& camera, const LodOptions& options, LodSelection<Node>& selection)
+	{
+		using Traits = OctreeTraversalTraits<Node>;
+
+		selection.clear();
+		candidates.clear();
+
+		auto push = [&](const Node& node, int level) {
+			const double weight = Weight(octree_region::Bounds(node), camera, options);
+			if (weight >= 0)
+			{
+				candidates.push_back({ weight, node, level });
+				std::push_heap(candidates.begin(), candidates.end());
+			}
+		};
+
+		push(root, Traits::Level(root));
+
+		Node children[8];
+		while (!candidates.empty())
+		{
+			std::pop_heap(candidates.begin(), candidates.end());
+			const Candidate candidate = candidates.back();
+			candidates.pop_back();
+
+			// A proxy node knows its bounds from its key, its point count and children only once its chunk is loaded
+			Traits::Prepare(candidate.node);
+
+			const uint64_t points = octree_lod::NumPoints(candidate.node);
+			if (selection.numPoints + points > options.pointBudget)
+			{
+				selection.budgetReached = true;
+				break;
+			}
+
+			selection.nodes.push_back(candidate.node);
+			selection.numPoints += points;
+
+			if (candidate.level >= options.maxLevel) {
+				continue;
+			}
+
+			const int count = Traits::Children(candidate.node, children);
+			for (int n = 0; n < count; ++n) {
+				push(children[n], candidate.level + 1);
+			}
+		}
+	}
+
+	LodSelection<Node> Select(const Node& root, const LodCamera& camera, const LodOptions& options = LodOptions())
+	{
+		LodSelection<Node> selection;
+		Select(root, camera, options, selection);
+		return selection;
+	}
+};
+
+#endif
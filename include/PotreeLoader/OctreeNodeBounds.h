@@ -0,0 +1,162 @@
+#pragma once
+#ifndef OCTREENODEBOUNDS_H
+#define OCTREENODEBOUNDS_H
+#include <bit>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "../ThirdParty/PotreeConverter/Geometry.h"
+#include "OctreeNodeKey.h"
+
+// SSE2 is part of every x64 target. Define POTREELOADER_NO_SIMD to use the scalar code instead
+#if !defined(POTREELOADER_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+	#define POTREELOADER_HAS_SSE2 1
+	#include <emmintrin.h>
+#else
+	#define POTREELOADER_HAS_SSE2 0
+#endif
+
+// AVX2 only with a compiler targeting it, e.g. /arch:AVX2 or -mavx2
+#if !defined(POTREELOADER_NO_SIMD) && defined(__AVX2__)
+	#define POTREELOADER_HAS_AVX2 1
+	#include <immintrin.h>
+#else
+	#define POTREELOADER_HAS_AVX2 0
+#endif
+
+// Bounding boxes of many nodes as separate coordinate arrays, the layout culling loops want
+struct BoundingBoxArrays
+{
+	std::vector<double> minX, minY, minZ;
+	std::vector<double> maxX, maxY, maxZ;
+
+	size_t size() const
+	{
+		return minX.size();
+	}
+
+	void resize(size_t count)
+	{
+		for (auto* values : { &minX, &minY, &minZ, &maxX, &maxY, &maxZ }) {
+			values->resize(count);
+		}
+	}
+
+	geometry::BoundingBox operator[](size_t i) const
+	{
+		return geometry::BoundingBox(geometry::Vector3(minX[i], minY[i], minZ[i]), geometry::Vector3(maxX[i], maxY[i], maxZ[i]));
+	}
+};
+
+// 2^-level, exact and without branches or library calls
+constexpr double InversePowerOfTwo(int level)
+{
+	return std::bit_cast<double>(static_cast<uint64_t>(1023 - level) << 52);
+}
+
+// Bounding box of a node, computed from the root box and the node key instead of being stored in the node.
+// The box is the cell of the node's grid position in the 2^level grid over the root box
+template<size_t Words>
+inline geometry::BoundingBox NodeBoundingBox(const geometry::BoundingBox& root, const BasicOctreeNodeKey<Words>& key)
+{
+	const OctreeGridPosition position = key.gridPosition();
+	const double scale = InversePowerOfTwo(key.level());
+
+	const geometry::Vector3 size((root.max.x - root.min.x) * scale, (root.max.y - root.min.y) * scale, (root.max.z - root.min.z) * scale);
+	const geometry::Vector3 min(
+		root.min.x + size.x * static_cast<double>(static_cast<int64_t>(position.x)),
+		root.min.y + size.y * static_cast<double>(static_cast<int64_t>(position.y)),
+		root.min.z + size.z * static_cast<double>(static_cast<int64_t>(position.z)));
+
+	return geometry::BoundingBox(min, geometry::Vector3(min.x + size.x, min.y + size.y, min.z + size.z));
+}
+
+// Bounding boxes of many nodes at once from their grid positions and levels. Positions are converted in blocks,
+// then the coordinates of a whole block are computed with SIMD. The boxes are written from index first on
+inline void NodeBoundingBoxes(const geometry::BoundingBox& root, const OctreeGridPosition* positions, const uint8_t* levels, size_t count, BoundingBoxArrays& boxes, size_t first = 0)
+{
+	constexpr size_t blockSize = 256;
+	alignas(16) double gridX[blockSize], gridY[blockSize], gridZ[blockSize], scale[blockSize];
+
+	const double rootMin[3] = { root.min.x, root.min.y, root.min.z };
+	const double rootSize[3] = { root.max.x - root.min.x, root.max.y - root.min.y, root.max.z - root.min.z };
+	const double* grids[3] = { gridX, gridY, gridZ };
+
+	if (boxes.size() < first + count) {
+		boxes.resize(first + count);
+	}
+
+	for (size_t start = 0; start < count; start += blockSize)
+	{
+		const size_t n = count - start < blockSize ? count - start : blockSize;
+
+		// Grid positions stay below 2^63, so the signed conversion is exact and a single instruction
+		for (size_t i = 0; i < n; ++i)
+		{
+			gridX[i] = static_cast<double>(static_cast<int64_t>(positions[start + i].x));
+			gridY[i] = static_cast<double>(static_cast<int64_t>(positions[start + i].y));
+			gridZ[i] = static_cast<double>(static_cast<int64_t>(positions[start + i].z));
+			scale[i] = InversePowerOfTwo(levels[start + i]);
+		}
+
+		double* mins[3] = { boxes.minX.data(), boxes.minY.data(), boxes.minZ.data() };
+		double* maxs[3] = { boxes.maxX.data(), boxes.maxY.data(), boxes.maxZ.data() };
+
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			const double* grid = grids[axis];
+			double* min = mins[axis] + first + start;
+			double* max = maxs[axis] + first + start;
+			size_t i = 0;
+
+#if POTREELOADER_HAS_SSE2
+			const __m128d origin = _mm_set1_pd(rootMin[axis]);
+			const __m128d extent = _mm_set1_pd(rootSize[axis]);
+			for (; i + 2 <= n; i += 2)
+			{
+				const __m128d size = _mm_mul_pd(extent, _mm_load_pd(scale + i));
+				const __m128d lower = _mm_add_pd(origin, _mm_mul_pd(size, _mm_load_pd(grid + i)));
+				_mm_storeu_pd(min + i, lower);
+				_mm_storeu_pd(max + i, _mm_add_pd(lower, size));
+			}
+#endif
+			for (; i < n; ++i)
+			{
+				const double size = rootSize[axis] * scale[i];
+				min[i] = rootMin[axis] + size * grid[i];
+				max[i] = min[i] + size;
+			}
+		}
+	}
+}
+
+// Bounding boxes of many nodes at once, decoding the keys block by block. boxes is resized to count
+template<size_t Words>
+inline void NodeBoundingBoxes(const geometry::BoundingBox& root, const BasicOctreeNodeKey<Words>* keys, size_t count, BoundingBoxArrays& boxes)
+{
+	constexpr size_t blockSize = 256;
+	OctreeGridPosition positions[blockSize];
+	uint8_t levels[blockSize];
+
+	boxes.resize(count);
+
+	for (size_t start = 0; start < count; start += blockSize)
+	{
+		const size_t n = count - start < blockSize ? count - start : blockSize;
+		for (size_t i = 0; i < n; ++i)
+		{
+			positions[i] = keys[start + i].gridPosition();
+			levels[i] = static_cast<uint8_t>(keys[start + i].level());
+		}
+
+		NodeBoundingBoxes(root, positions, levels, n, boxes, start);
+	}
+}
+
+template<size_t Words>
+inline void NodeBoundingBoxes(const geometry::BoundingBox& root, const std::vector<BasicOctreeNodeKey<Words>>& keys, BoundingBoxArrays& boxes)
+{
+	NodeBoundingBoxes(root, keys.data(), keys.size(), boxes);
+}
+
+#endif
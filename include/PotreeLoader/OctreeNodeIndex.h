@@ -0,0 +1,193 @@
+#pragma once
+#ifndef OCTREENODEINDEX_H
+#define OCTREENODEINDEX_H
+#include <bit>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <stdexcept>
+#include <functional>
+#include "OctreeNodeKey.h"
+#include "OctreeNodeBounds.h" // POTREELOADER_HAS_SSE2
+
+// Hash index from node key to node handle, e.g. a node pointer or a node table index. Open addressing with linear probing
+// over one flat array, so a lookup usually touches a single cache line. Empty marks free slots and cannot be stored
+template<typename Value, Value Empty = Value{}>
+class OctreeNodeIndex
+{
+	struct Slot
+	{
+		OctreeNodeKey key;
+		Value value = Empty;
+	};
+
+	std::vector<Slot> slots;
+	size_t node_count = 0;
+
+	size_t SlotOf(const OctreeNodeKey& key) const
+	{
+		return std::hash<OctreeNodeKey>()(key) & (slots.size() - 1);
+	}
+
+	// At most 3/4 of the slots are used, which keeps probe sequences short
+	static size_t CapacityFor(size_t count)
+	{
+		return std::bit_ceil((std::max)(count + count / 3 + 1, size_t(16)));
+	}
+
+public:
+	// Keys prefetched ahead of the one being inserted or looked up
+	static constexpr size_t prefetchDistance = 16;
+
+	OctreeNodeIndex() = default;
+
+	explicit OctreeNodeIndex(size_t expectedCount)
+	{
+		Reserve(expectedCount);
+	}
+
+	size_t size() const
+	{
+		return node_count;
+	}
+
+	void Reserve(size_t count)
+	{
+		const size_t capacity = CapacityFor(count);
+		if (capacity <= slots.size()) {
+			return;
+		}
+
+		std::vector<Slot> previous(capacity);
+		previous.swap(slots);
+		node_count = 0;
+
+		for (const Slot& slot : previous)
+		{
+			if (slot.value != Empty) {
+				Insert(slot.key, slot.value);
+			}
+		}
+	}
+
+	// Inserts the node or replaces the value stored for its key
+	void Insert(const OctreeNodeKey& key, Value value)
+	{
+		if (value == Empty) {
+			throw std::invalid_argument("The empty value cannot be stored in a node index: " + key.name());
+		}
+
+		if (slots.empty() || CapacityFor(node_count + 1) > slots.size()) {
+			Reserve((std::max)(node_count + 1, 2 * node_count));
+		}
+
+		for (size_t i = SlotOf(key);; i = (i + 1) & (slots.size() - 1))
+		{
+			Slot& slot = slots[i];
+			if (slot.value == Empty)
+			{
+				slot.key = key;
+				slot.value = value;
+				++node_count;
+				return;
+			}
+			if (slot.key == key)
+			{
+				slot.value = value;
+				return;
+			}
+		}
+	}
+
+	// Hints that key is inserted or looked up soon. Filling a large index is bound by cache misses,
+	// prefetching a few keys ahead overlaps them
+	void Prefetch(const OctreeNodeKey& key) const
+	{
+#if POTREELOADER_HAS_SSE2
+		if (!slots.empty()) {
+			_mm_prefetch(reinterpret_cast<const char*>(&slots[SlotOf(key)]), _MM_HINT_T0);
+		}
+#else
+		(void)key;
+#endif
+	}
+
+	// Empty if there is no node with this key
+	Value Find(const OctreeNodeKey& key) const
+	{
+		if (slots.empty()) {
+			return Empty;
+		}
+
+		for (size_t i = SlotOf(key);; i = (i + 1) & (slots.size() - 1))
+		{
+			const Slot& slot = slots[i];
+			if (slot.value == Empty || slot.key == key) {
+				return slot.value;
+			}
+		}
+	}
+
+	Value Find(std::string_view name) const
+	{
+		return Find(OctreeNodeKey::FromName(name));
+	}
+
+	// Looks up many keys at once. The slots of a block of keys are prefetched before they are probed,
+	// so the cache misses of the block overlap instead of being paid one after another
+	void Find(const OctreeNodeKey* keys, size_t count, Value* values) const
+	{
+		size_t first[prefetchDistance];
+
+		if (slots.empty())
+		{
+			std::fill(values, values + count, Empty);
+			return;
+		}
+
+		for (size_t start = 0; start < count; start += prefetchDistance)
+		{
+			const size_t n = (std::min)(count - start, prefetchDistance);
+			for (size_t i = 0; i < n; ++i)
+			{
+				first[i] = SlotOf(keys[start + i]);
+				Prefetch(keys[start + i]);
+			}
+
+			for (size_t i = 0; i < n; ++i)
+			{
+				for (size_t slot = first[i];; slot = (slot + 1) & (slots.size() - 1))
+				{
+					if (slots[slot].value == Empty || slots[slot].key == keys[start + i])
+					{
+						values[start + i] = slots[slot].value;
+						break;
+					}
+				}
+			}
+		}
+	}
+
+	std::vector<Value> Find(const std::vector<OctreeNodeKey>& keys) const
+	{
+		std::vector<Value> values(keys.size());
+		Find(keys.data(), keys.size(), values.data());
+		return values;
+	}
+
+	void Clear()
+	{
+		slots.clear();
+		node_count = 0;
+	}
+
+	size_t MemoryUsage() const
+	{
+		return slots.size() * sizeof(Slot);
+	}
+};
+
+#endif
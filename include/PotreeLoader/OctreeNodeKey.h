@@ -0,0 +1,242 @@
+#pragma once
+#ifndef OCTREENODEKEY_H
+#define OCTREENODEKEY_H
+#include <array>
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cstddef>
+#include <compare>
+#include <stdexcept>
+#include <functional>
+
+// Position of a node within the grid of its level, see BasicOctreeNodeKey::gridPosition
+struct OctreeGridPosition
+{
+	uint64_t x = 0;
+	uint64_t y = 0;
+	uint64_t z = 0;
+};
+
+// Integer identity of an octree node, replacing the node name ("r0426...") as key.
+// The octant path is stored left-aligned, three bits per level with the first octant in the most significant bits,
+// and the level in the lowest bits. So comparing keys orders nodes like their names: depth-first pre-order,
+// a node before its children and the children in octant order.
+// Words is the number of 64 bit words: one word holds paths up to level 19, two words up to level 40
+template<size_t Words>
+class BasicOctreeNodeKey
+{
+	static_assert(Words > 0, "A node key needs at least one word");
+
+	static constexpr int totalBits = static_cast<int>(64 * Words);
+
+	static constexpr int LevelBitsFor()
+	{
+		int bits = 1;
+		while ((1 << bits) <= (totalBits - bits) / 3) {
+			++bits;
+		}
+		return bits;
+	}
+
+public:
+	static constexpr int levelBits = LevelBitsFor();
+	static constexpr int maxLevel = (totalBits - levelBits) / 3;
+
+	constexpr BasicOctreeNodeKey() = default;
+
+	static constexpr BasicOctreeNodeKey Root()
+	{
+		return BasicOctreeNodeKey();
+	}
+
+	constexpr int level() const
+	{
+		return static_cast<int>(words[Words - 1] & ((uint64_t(1) << levelBits) - 1));
+	}
+
+	constexpr bool isRoot() const
+	{
+		return level() == 0;
+	}
+
+	// Octant of the ancestor at the given depth (1 to level), i.e. the depth-th digit of the name
+	constexpr int octant(int depth) const
+	{
+		return static_cast<int>(bits(3 * (depth - 1)) >> 61);
+	}
+
+	// Position within the parent, -1 for the root
+	constexpr int octant() const
+	{
+		return isRoot() ? -1 : octant(level());
+	}
+
+	constexpr BasicOctreeNodeKey child(int octant) const
+	{
+		const int depth = level();
+		if (depth >= maxLevel) {
+			throw std::out_of_range("Octree node key cannot hold nodes deeper than level " + std::to_string(maxLevel));
+		}
+
+		// The path bits below the level are zero, so the octant is or-ed in
+		BasicOctreeNodeKey key = *this;
+		const int position = 3 * depth;
+		const size_t word = static_cast<size_t>(position / 64);
+		const int offset = position % 64;
+		const uint64_t value = static_cast<uint64_t>(octant & 7) << 61;
+		key.words[word] |= value >> offset;
+		if (offset > 61) {
+			key.words[word + 1] |= value << (64 - offset);
+		}
+		key.setLevel(depth + 1);
+		return key;
+	}
+
+	constexpr BasicOctreeNodeKey parent() const
+	{
+		return ancestor(level() - 1);
+	}
+
+	// Ancestor at the given level (0 is the root)
+	constexpr BasicOctreeNodeKey ancestor(int ancestorLevel) const
+	{
+		if (ancestorLevel < 0 || ancestorLevel > level()) {
+			throw std::out_of_range("Octree node key has no ancestor at level " + std::to_string(ancestorLevel));
+		}
+
+		// Keep the bits before the ancestor's end of path, clear the others including the level
+		BasicOctreeNodeKey key = *this;
+		const int end = 3 * ancestorLevel;
+		for (size_t i = 0; i < Words; ++i)
+		{
+			const int kept = end - static_cast<int>(64 * i);
+			const uint64_t mask = kept <= 0 ? 0 : kept >= 64 ? ~uint64_t(0) : ~(~uint64_t(0) >> kept);
+			key.words[i] &= mask;
+		}
+		key.setLevel(ancestorLevel);
+		return key;
+	}
+
+	// True for the node itself and all of its ancestors
+	constexpr bool contains(const BasicOctreeNodeKey& other) const
+	{
+		return other.level() >= level() && other.ancestor(level()) == *this;
+	}
+
+	// Node name like "r0426"
+	constexpr std::string name() const
+	{
+		std::string result(static_cast<size_t>(level()) + 1, 'r');
+		for (int depth = 1; depth <= level(); ++depth) {
+			result[static_cast<size_t>(depth)] = static_cast<char>('0' + octant(depth));
+		}
+		return result;
+	}
+
+	static constexpr BasicOctreeNodeKey FromName(std::string_view name)
+	{
+		if (name.empty() || name[0] != 'r') {
+			throw std::invalid_argument("Octree node names start with 'r': " + std::string(name));
+		}
+
+		BasicOctreeNodeKey key;
+		for (size_t i = 1; i < name.size(); ++i)
+		{
+			if (name[i] < '0' || name[i] > '7') {
+				throw std::invalid_argument("Invalid octant in octree node name: " + std::string(name));
+			}
+			key = key.child(name[i] - '0');
+		}
+		return key;
+	}
+
+	// Integer position of the node within the 2^level grid of its level. Octant bits: 4 = x, 2 = y, 1 = z.
+	// The path is decoded without branches in segments of 21 levels, then shifted down to the node's level.
+	// Only segments holding path bits are decoded, which is a single one up to level 21
+	constexpr OctreeGridPosition gridPosition() const
+	{
+		static_assert((maxLevel + 20) / 21 * 21 <= 64, "Grid positions of this key size do not fit 64 bit");
+
+		const int segments = (level() + 20) / 21;
+		OctreeGridPosition position;
+		for (int i = 0; i < segments; ++i)
+		{
+			// 63 path bits. Level bits read at the end lie past maxLevel and are shifted out below
+			const uint64_t segment = bits(63 * i) >> 1;
+			position.x = (position.x << 21) | CompactEveryThirdBit(segment >> 2);
+			position.y = (position.y << 21) | CompactEveryThirdBit(segment >> 1);
+			position.z = (position.z << 21) | CompactEveryThirdBit(segment);
+		}
+
+		const int unused = 21 * segments - level();
+		position.x >>= unused;
+		position.y >>= unused;
+		position.z >>= unused;
+		return position;
+	}
+
+	constexpr const std::array<uint64_t, Words>& data() const
+	{
+		return words;
+	}
+
+	constexpr bool operator==(const BasicOctreeNodeKey&) const = default;
+	constexpr auto operator<=>(const BasicOctreeNodeKey&) const = default;
+
+private:
+	std::array<uint64_t, Words> words{};
+
+	// 64 bits starting at the position, zero filled past the last word.
+	// Bit positions count from the most significant bit of the first word
+	constexpr uint64_t bits(int position) const
+	{
+		const size_t word = static_cast<size_t>(position / 64);
+		const int offset = position % 64;
+		const uint64_t next = word + 1 < Words ? words[word + 1] : 0;
+		return (words[word] << offset) | ((next >> 1) >> (63 - offset));
+	}
+
+	// Gathers bits 0, 3, 6, ... into the lowest 21 bits
+	static constexpr uint64_t CompactEveryThirdBit(uint64_t value)
+	{
+		value &= 0x1249249249249249ull;
+		value = (value ^ (value >> 2)) & 0x10c30c30c30c30c3ull;
+		value = (value ^ (value >> 4)) & 0x100f00f00f00f00full;
+		value = (value ^ (value >> 8)) & 0x1f0000ff0000ffull;
+		value = (value ^ (value >> 16)) & 0x1f00000000ffffull;
+		value = (value ^ (value >> 32)) & 0x1fffffull;
+		return value;
+	}
+
+	constexpr void setLevel(int newLevel)
+	{
+		const uint64_t mask = (uint64_t(1) << levelBits) - 1;
+		words[Words - 1] = (words[Words - 1] & ~mask) | static_cast<uint64_t>(newLevel);
+	}
+};
+
+using OctreeNodeKey64 = BasicOctreeNodeKey<1>;
+using OctreeNodeKey128 = BasicOctreeNodeKey<2>;
+
+// Key used by the hierarchy. 128 bit, so deep octrees do not run out of levels
+using OctreeNodeKey = OctreeNodeKey128;
+
+template<size_t Words>
+struct std::hash<BasicOctreeNodeKey<Words>>
+{
+	size_t operator()(const BasicOctreeNodeKey<Words>& key) const noexcept
+	{
+		uint64_t hash = 0;
+		for (uint64_t word : key.data()) {
+			// Mixing step of splitmix64
+			hash ^= word + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+			hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ull;
+			hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebull;
+			hash ^= hash >> 31;
+		}
+		return static_cast<size_t>(hash);
+	}
+};
+
+#endif
@@ -0,0 +1,532 @@
+#pragma once
+#ifndef OCTREENODETABLE_H
+#define OCTREENODETABLE_H
+#include <bit>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <functional>
+#include <unordered_map>
+#include "../ThirdParty/PotreeConverter/Geometry.h"
+#include "ByteSource.h"
+#include "OctreeNodeKey.h"
+#include "OctreeNodeBounds.h"
+#include "OctreeNodeIndex.h"
+#include "OctreeTraversal.h"
+
+class OctreeNodeTable;
+
+// Lightweight handle to one node of an OctreeNodeTable. Mirrors the accessors of OctreeGeometryNode.
+// Cheap to copy, valid as long as the table lives
+class OctreeTableNode
+{
+	const OctreeNodeTable* table = nullptr;
+	uint32_t node_index = UINT32_MAX;
+
+public:
+	OctreeTableNode() = default;
+	OctreeTableNode(const OctreeNodeTable* table, uint32_t index) : table(table), node_index(index) {}
+
+	bool valid() const { return table != nullptr && node_index != UINT32_MAX; }
+	uint32_t index() const { return node_index; }
+
+	inline uint64_t byteOffset() const;
+	inline uint64_t byteSize() const;
+	inline uint32_t numPoints() const;
+	inline uint8_t childMask() const;
+	inline int level() const;
+	inline uint8_t nodeType() const;
+	inline double spacing() const;
+
+	inline bool hasChildren() const;
+	inline int childCount() const;
+	inline OctreeTableNode child(int n) const;       // n-th existing child, in octant order
+	inline OctreeTableNode childAt(int octant) const; // Invalid node if the octant has no child
+	inline OctreeTableNode parent() const;            // Invalid node for the root
+	inline int octant() const;                        // Position within the parent, -1 for the root
+
+	inline OctreeNodeKey key() const;
+	inline std::string name() const;
+	inline geometry::BoundingBox boundingBox() const;
+
+	bool operator==(const OctreeTableNode& rhs) const
+	{
+		return table == rhs.table && node_index == rhs.node_index;
+	}
+};
+
+// Hierarchy as contiguous arrays (structure of arrays) in breadth-first order instead of one heap object per node.
+// 27 bytes per node. The children of a node are stored next to each other starting at firstChild, in octant order,
+// so every level is a contiguous range and a linear pass over the arrays visits parents before children
+class OctreeNodeTable
+{
+public:
+	static constexpr uint32_t npos = UINT32_MAX;
+
+	std::vector<uint64_t> byteOffset;
+	std::vector<uint32_t> byteSize;
+	std::vector<uint32_t> numPoints;
+	std::vector<uint32_t> firstChild;
+	std::vector<uint32_t> parent;
+	std::vector<uint8_t> childMask;
+	std::vector<uint8_t> level;
+	std::vector<uint8_t> nodeType;
+
+	geometry::BoundingBox rootBoundingBox;
+	double rootSpacing = 0.0;
+
+	// Table index of each node key, see BuildIndex. Not part of the node bytes below
+	OctreeNodeIndex<uint32_t, npos> index;
+
+	static constexpr size_t bytesPerNode = sizeof(uint64_t) + 4 * sizeof(uint32_t) + 3 * sizeof(uint8_t);
+
+	size_t size() const
+	{
+		return byteOffset.size();
+	}
+
+	OctreeTableNode Root() const
+	{
+		return size() > 0 ? OctreeTableNode(this, 0) : OctreeTableNode();
+	}
+
+	OctreeTableNode Node(uint32_t index) const
+	{
+		return OctreeTableNode(this, index);
+	}
+
+	// Calls function with each array in member order, e.g. to serialize the table
+	template<typename Function>
+	void ForEachArray(Function&& function)
+	{
+		function(byteOffset);
+		function(byteSize);
+		function(numPoints);
+		function(firstChild);
+		function(parent);
+		function(childMask);
+		function(level);
+		function(nodeType);
+	}
+
+	template<typename Function>
+	void ForEachArray(Function&& function) const
+	{
+		const_cast<OctreeNodeTable*>(this)->ForEachArray([&function](const auto& values) { function(values); });
+	}
+
+	// Keys of all nodes in table order, derived in one pass because parents come before their children
+	std::vector<OctreeNodeKey> Keys() const
+	{
+		std::vector<OctreeNodeKey> keys(size());
+		for (size_t index = 0; index < size(); ++index)
+		{
+			uint32_t child = firstChild[index];
+			for (int octant = 0; octant < 8; ++octant)
+			{
+				if ((childMask[index] >> octant) & 1) {
+					keys[child++] = keys[index].child(octant);
+				}
+			}
+		}
+		return keys;
+	}
+
+	// Checks the layout described above, which traversals, Keys and the node objects built from a table rely on, e.g. for a table
+	// read from a snapshot: the children of each node follow the children of all earlier nodes, after the node itself, and their
+	// parents and levels match. Throws std::runtime_error naming the source of the table otherwise
+	void Validate(const std::string& name) const
+	{
+		const size_t count = size();
+		for (const size_t arraySize : { byteSize.size(), numPoints.size(), firstChild.size(), parent.size(), childMask.size(), level.size(), nodeType.size() }) {
+			if (arraySize != count) {
+				throw std::runtime_error("Node table arrays differ in size: " + name);
+			}
+		}
+		if (count == 0) {
+			return;
+		}
+		if (parent[0] != npos || level[0] != 0) {
+			throw std::runtime_error("Node table does not start with the root node: " + name);
+		}
+
+		uint64_t nextChild = 1;
+		for (size_t index = 0; index < count; ++index)
+		{
+			const int childCount = std::popcount(childMask[index]);
+			if (childCount == 0) {
+				continue;
+			}
+
+			if (firstChild[index] != nextChild || firstChild[index] <= index || nextChild + childCount > count || level[index] >= OctreeNodeKey::maxLevel) {
+				throw std::runtime_error("Node table children of node " + std::to_string(index) + " are out of order: " + name);
+			}
+
+			for (uint64_t child = nextChild; child < nextChild + childCount; ++child) {
+				if (parent[child] != index || level[child] != level[index] + 1) {
+					throw std::runtime_error("Node table parent or level of node " + std::to_string(child) + " does not match: " + name);
+				}
+			}
+			nextChild += childCount;
+		}
+
+		if (nextChild != count) {
+			throw std::runtime_error("Node table holds nodes without parent: " + name);
+		}
+	}
+
+	// Indexes all nodes by key for constant time Find. Call it once the arrays are complete, Octree does so while loading
+	void BuildIndex()
+	{
+		const auto keys = Keys();
+		index = OctreeNodeIndex<uint32_t, npos>(keys.size());
+		for (size_t i = 0; i < keys.size(); ++i)
+		{
+			if (i + index.prefetchDistance < keys.size()) {
+				index.Prefetch(keys[i + index.prefetchDistance]);
+			}
+			index.Insert(keys[i], static_cast<uint32_t>(i));
+		}
+	}
+
+	// Node with the given key, invalid if there is none. Without an up to date index the node is searched from the root down
+	OctreeTableNode Find(const OctreeNodeKey& key) const
+	{
+		if (index.size() == size()) {
+			const uint32_t found = index.Find(key);
+			return found == npos ? OctreeTableNode() : Node(found);
+		}
+
+		OctreeTableNode node = Root();
+		for (int depth = 1; depth <= key.level() && node.valid(); ++depth) {
+			node = node.childAt(key.octant(depth));
+		}
+		return node;
+	}
+
+	OctreeTableNode Find(std::string_view name) const
+	{
+		return Find(OctreeNodeKey::FromName(name));
+	}
+
+	// Looks up many keys at once, see OctreeNodeIndex::Find
+	std::vector<OctreeTableNode> Find(const std::vector<OctreeNodeKey>& keys) const
+	{
+		std::vector<OctreeTableNode> nodes(keys.size());
+		if (index.size() != size())
+		{
+			for (size_t i = 0; i < keys.size(); ++i) {
+				nodes[i] = Find(keys[i]);
+			}
+			return nodes;
+		}
+
+		const auto found = index.Find(keys);
+		for (size_t i = 0; i < keys.size(); ++i) {
+			nodes[i] = found[i] == npos ? OctreeTableNode() : Node(found[i]);
+		}
+		return nodes;
+	}
+
+	// Grid positions of all nodes in table order, see BasicOctreeNodeKey::gridPosition.
+	// A child's position is twice its parent's plus its octant bits, so no keys are decoded
+	std::vector<OctreeGridPosition> GridPositions() const
+	{
+		std::vector<OctreeGridPosition> positions(size());
+		for (size_t index = 0; index < size(); ++index)
+		{
+			const OctreeGridPosition& position = positions[index];
+			uint32_t child = firstChild[index];
+			for (int octant = 0; octant < 8; ++octant)
+			{
+				if ((childMask[index] >> octant) & 1) {
+					positions[child++] = { 2 * position.x + ((octant >> 2) & 1), 2 * position.y + ((octant >> 1) & 1), 2 * position.z + (octant & 1) };
+				}
+			}
+		}
+		return positions;
+	}
+
+	// Bounding boxes of all nodes in table order, computed in batches
+	void BoundingBoxes(BoundingBoxArrays& boxes) const
+	{
+		boxes.resize(size());
+		NodeBoundingBoxes(rootBoundingBox, GridPositions().data(), level.data(), size(), boxes);
+	}
+
+	// Position of the n-th set bit of a child mask
+	static int NthChildOctant(uint8_t mask, int n)
+	{
+		for (int octant = 0; octant < 8; ++octant)
+		{
+			if ((mask >> octant) & 1)
+			{
+				if (n == 0) {
+					return octant;
+				}
+				--n;
+			}
+		}
+		return -1;
+	}
+
+	// Depth-first pre-order, like OctreeGeometryNode::traverse. See TraverseDepthFirst for more traversal orders
+	template<typename Callback>
+	void traverse(Callback&& callback) const
+	{
+		if (size() > 0) {
+			TraverseDepthFirst(Root(), [&callback](OctreeTableNode node, int nodeLevel) {
+				callback(node, nodeLevel);
+			});
+		}
+	}
+
+	// Depth-first pre-order over the nodes within the level range, without entering deeper subtrees
+	template<typename Callback>
+	void traverse(Callback&& callback, const LevelRange& levels) const
+	{
+		traverse_conditional(callback, [](OctreeTableNode, int) { return true; }, levels);
+	}
+
+	// Depth-first pre-order. Subtrees of nodes which fail the condition are skipped
+	template<typename Callback, typename Condition>
+	void traverse_conditional(Callback&& callback, Condition&& condition, const LevelRange& levels = LevelRange()) const
+	{
+		if (size() > 0) {
+			TraverseDepthFirst(Root(), [&callback, &condition, &levels](OctreeTableNode node, int nodeLevel) {
+				if (!condition(node, nodeLevel)) {
+					return TraversalAction::SkipChildren;
+				}
+				if (levels.contains(nodeLevel)) {
+					callback(node, nodeLevel);
+				}
+				return TraversalAction::Continue;
+			}, LevelRange::UpTo(levels.maxLevel));
+		}
+	}
+
+	// Builds the table from hierarchy.bin. Proxy records are resolved to the first record of their chunk.
+	// Within a chunk the children of the non-proxy records follow the root record in record order, which gives
+	// each record's first child position in its chunk
+	static OctreeNodeTable Load(const ByteSource& hierarchySource, uint64_t firstChunkSize, const geometry::BoundingBox& rootBoundingBox, double rootSpacing)
+	{
+		const auto content = hierarchySource.ReadAll();
+		return Load(content.data(), content.size(), firstChunkSize, rootBoundingBox, rootSpacing);
+	}
+
+	static OctreeNodeTable Load(const uint8_t* hierarchy, size_t hierarchySize, uint64_t firstChunkSize, const geometry::BoundingBox& rootBoundingBox, double rootSpacing)
+	{
+		const size_t bytesPerRecord = 22;
+
+		struct Record
+		{
+			uint8_t type;
+			uint8_t childMask;
+			uint32_t numPoints;
+			uint64_t byteOffset;
+			uint64_t byteSize;
+		};
+
+		auto readRecord = [&](uint64_t chunkOffset, uint64_t chunkSize, uint32_t local) {
+			if (local >= chunkSize / bytesPerRecord) {
+				throw std::out_of_range("Hierarchy child record lies outside of its chunk!");
+			}
+
+			const uint64_t position = chunkOffset + static_cast<uint64_t>(local) * bytesPerRecord;
+			if (position > hierarchySize || bytesPerRecord > hierarchySize - position) {
+				throw std::out_of_range("Hierarchy record overruns the hierarchy size!");
+			}
+
+			Record record;
+			const uint8_t* source = hierarchy + position;
+			record.type = source[0];
+			record.childMask = source[1];
+			memcpy(&record.numPoints, source + 2, sizeof(uint32_t));
+			memcpy(&record.byteOffset, source + 6, sizeof(uint64_t));
+			memcpy(&record.byteSize, source + 14, sizeof(uint64_t));
+			return record;
+		};
+
+		// Position of each record's first child within its chunk
+		std::unordered_map<uint64_t, std::vector<uint32_t>> chunkChildStarts;
+		auto childStarts = [&](uint64_t chunkOffset, uint64_t chunkSize) -> const std::vector<uint32_t>& {
+			auto it = chunkChildStarts.find(chunkOffset);
+			if (it != chunkChildStarts.end()) {
+				return it->second;
+			}
+
+			if (chunkOffset > hierarchySize || chunkSize > hierarchySize - chunkOffset) {
+				throw std::out_of_range("Hierarchy Node count overruns the buffer size!");
+			}
+
+			const uint32_t count = static_cast<uint32_t>(chunkSize / bytesPerRecord);
+			std::vector<uint32_t> starts(count);
+			uint32_t next = 1;
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				starts[i] = next;
+				const uint8_t* source = hierarchy + chunkOffset + static_cast<uint64_t>(i) * bytesPerRecord;
+				if (source[0] != 2) { // Proxies have their children in their own chunk
+					next += static_cast<uint32_t>(std::popcount(source[1]));
+				}
+			}
+
+			return chunkChildStarts.emplace(chunkOffset, std::move(starts)).first->second;
+		};
+
+		OctreeNodeTable table;
+		table.rootBoundingBox = rootBoundingBox;
+		table.rootSpacing = rootSpacing;
+
+		if (hierarchySize < bytesPerRecord) {
+			return table;
+		}
+
+		// Breadth first, refs[i] locates the record of table node i
+		struct Ref
+		{
+			uint64_t chunkOffset;
+			uint64_t chunkSize;
+			uint32_t local;
+		};
+		std::vector<Ref> refs{ { 0, firstChunkSize, 0 } };
+		refs.reserve(hierarchySize / bytesPerRecord);
+		table.Reserve(hierarchySize / bytesPerRecord);
+		table.parent.push_back(npos);
+		table.level.push_back(0);
+
+		for (size_t i = 0; i < refs.size(); ++i)
+		{
+			Ref ref = refs[i];
+			Record record = readRecord(ref.chunkOffset, ref.chunkSize, ref.local);
+
+			if (record.type == 2)
+			{
+				// Same checks as HierarchyView::MakeNode, the chunk has to consist of whole records within the hierarchy
+				if (record.byteOffset % bytesPerRecord != 0 || record.byteSize < bytesPerRecord || record.byteOffset > hierarchySize || record.byteSize > hierarchySize - record.byteOffset) {
+					throw std::out_of_range("Hierarchy chunk of proxy node reaches beyond the hierarchy: " + std::to_string(i));
+				}
+
+				ref = { record.byteOffset, record.byteSize, 0 };
+				record = readRecord(ref.chunkOffset, ref.chunkSize, 0);
+			}
+
+			if (record.byteSize > UINT32_MAX || refs.size() >= npos) {
+				throw std::out_of_range("Node does not fit into the node table: " + std::to_string(i));
+			}
+
+			table.byteOffset.push_back(record.byteOffset);
+			table.byteSize.push_back(static_cast<uint32_t>(record.byteSize));
+			table.numPoints.push_back(record.byteSize == 0 ? 0 : record.numPoints);
+			table.childMask.push_back(record.childMask);
+			table.nodeType.push_back(record.type);
+			table.firstChild.push_back(static_cast<uint32_t>(refs.size()));
+
+			const int childCount = std::popcount(record.childMask);
+			if (childCount == 0) {
+				continue;
+			}
+
+			const uint32_t firstChildRecord = childStarts(ref.chunkOffset, ref.chunkSize)[ref.local];
+			if (static_cast<uint64_t>(firstChildRecord) + childCount > ref.chunkSize / bytesPerRecord) {
+				throw std::out_of_range("Hierarchy child record lies outside of its chunk: " + std::to_string(i));
+			}
+
+			for (int n = 0; n < childCount; ++n)
+			{
+				refs.push_back({ ref.chunkOffset, ref.chunkSize, firstChildRecord + static_cast<uint32_t>(n) });
+				table.parent.push_back(static_cast<uint32_t>(i));
+				table.level.push_back(static_cast<uint8_t>(table.level[i] + 1));
+			}
+		}
+
+		return table;
+	}
+
+private:
+	void Reserve(size_t count)
+	{
+		byteOffset.reserve(count);
+		byteSize.reserve(count);
+		numPoints.reserve(count);
+		firstChild.reserve(count);
+		parent.reserve(count);
+		childMask.reserve(count);
+		level.reserve(count);
+		nodeType.reserve(count);
+	}
+};
+
+inline uint64_t OctreeTableNode::byteOffset() const { return table->byteOffset[node_index]; }
+inline uint64_t OctreeTableNode::byteSize() const { return table->byteSize[node_index]; }
+inline uint32_t OctreeTableNode::numPoints() const { return table->numPoints[node_index]; }
+inline uint8_t OctreeTableNode::childMask() const { return table->childMask[node_index]; }
+inline int OctreeTableNode::level() const { return table->level[node_index]; }
+inline uint8_t OctreeTableNode::nodeType() const { return table->nodeType[node_index]; }
+inline double OctreeTableNode::spacing() const { return table->rootSpacing / static_cast<double>(uint64_t(1) << level()); }
+inline bool OctreeTableNode::hasChildren() const { return childMask() != 0; }
+inline int OctreeTableNode::childCount() const { return std::popcount(childMask()); }
+
+inline OctreeTableNode OctreeTableNode::child(int n) const
+{
+	return n >= 0 && n < childCount() ? OctreeTableNode(table, table->firstChild[node_index] + static_cast<uint32_t>(n)) : OctreeTableNode();
+}
+
+inline OctreeTableNode OctreeTableNode::childAt(int octant) const
+{
+	const uint8_t mask = childMask();
+	if (octant < 0 || octant > 7 || ((mask >> octant) & 1) == 0) {
+		return OctreeTableNode();
+	}
+
+	// Children before this octant
+	const int n = std::popcount(mask & ((1u << octant) - 1));
+	return OctreeTableNode(table, table->firstChild[node_index] + static_cast<uint32_t>(n));
+}
+
+inline OctreeTableNode OctreeTableNode::parent() const
+{
+	const uint32_t parentIndex = table->parent[node_index];
+	return parentIndex == OctreeNodeTable::npos ? OctreeTableNode() : OctreeTableNode(table, parentIndex);
+}
+
+inline int OctreeTableNode::octant() const
+{
+	const uint32_t parentIndex = table->parent[node_index];
+	if (parentIndex == OctreeNodeTable::npos) {
+		return -1;
+	}
+	return OctreeNodeTable::NthChildOctant(table->childMask[parentIndex], static_cast<int>(node_index - table->firstChild[parentIndex]));
+}
+
+inline OctreeNodeKey OctreeTableNode::key() const
+{
+	int path[OctreeNodeKey::maxLevel];
+	int depth = 0;
+	for (OctreeTableNode node = *this; node.octant() >= 0; node = node.parent()) {
+		if (depth == OctreeNodeKey::maxLevel) {
+			throw std::out_of_range("Octree node key cannot hold nodes deeper than level " + std::to_string(OctreeNodeKey::maxLevel));
+		}
+		path[depth++] = node.octant();
+	}
+
+	OctreeNodeKey result;
+	while (depth > 0) {
+		result = result.child(path[--depth]);
+	}
+	return result;
+}
+
+inline std::string OctreeTableNode::name() const
+{
+	return key().name();
+}
+
+inline geometry::BoundingBox OctreeTableNode::boundingBox() const
+{
+	return NodeBoundingBox(table->rootBoundingBox, key());
+}
+
+#endif
@@ -0,0 +1,134 @@
+#pragma once
+#ifndef OCTREEPREFETCHER_H
+#define OCTREEPREFETCHER_H
+#include <vector>
+#include <mutex>
+#include <functional>
+#include <unordered_set>
+#include <cstdint>
+
+struct PrefetchPolicy
+{
+	bool enabled = false;
+	int depth = 1;                           // 1 hints the children of a loaded node, 2 also the grandchildren, ...
+	uint64_t byteBudget = 4 * 1024 * 1024;  // Upper limit of bytes hinted per loaded node
+	size_t maxPendingHints = 1 << 16;       // Hints which were not followed by a load are forgotten beyond this count
+};
+
+struct PrefetchStats
+{
+	uint64_t hintsIssued = 0; // Nodes which were hinted
+	uint64_t bytesHinted = 0;
+	uint64_t hits = 0;        // Loads of nodes which were hinted before
+	uint64_t misses = 0;      // Loads of nodes which were not hinted
+	uint64_t expired = 0;     // Hinted nodes which were forgotten before they got loaded
+
+	double HitRate() const
+	{
+		return (hits + misses) > 0 ? static_cast<double>(hits) / static_cast<double>(hits + misses) : 0.0;
+	}
+
+	// Share of hints that were followed by a load of the node
+	double HintAccuracy() const
+	{
+		return hintsIssued > 0 ? static_cast<double>(hits) / static_cast<double>(hintsIssued) : 0.0;
+	}
+};
+
+// Issues readahead hints for the descendants of loaded nodes, since those are most likely requested next.
+// Keeps track of hinted nodes to report whether the hints paid off. Thread-safe
+class OctreePrefetcher
+{
+	PrefetchPolicy policy;
+	PrefetchStats stats;
+	std::unordered_set<const OctreeGeometryNode*> pending;
+	mutable std::mutex prefetch_mutex;
+
+public:
+	OctreePrefetcher(const PrefetchPolicy& policy) : policy(policy) {}
+
+	// Records whether the node was hinted and hints its descendants up to the policy depth.
+	// 'hint' receives the byte range of every hinted node
+	void OnNodeLoad(const OctreeGeometryNode* node, const std::function<void(uint64_t, uint64_t)>& hint)
+	{
+		std::vector<const OctreeGeometryNode*> hinted;
+
+		{
+			std::lock_guard<std::mutex> lock(prefetch_mutex);
+
+			if (pending.erase(node) > 0) {
+				++stats.hits;
+			}
+			else {
+				++stats.misses;
+			}
+
+			if (!policy.enabled || policy.depth <= 0) {
+				return;
+			}
+
+			// Breadth first, so children are hinted before grandchildren when the budget runs out
+			std::vector<const OctreeGeometryNode*> level{ node };
+			uint64_t budget = policy.byteBudget;
+
+			for (int depth = 0; depth < policy.depth && !level.empty() && budget > 0; ++depth)
+			{
+				std::vector<const OctreeGeometryNode*> next;
+
+				for (const auto* current : level)
+				{
+					for (const auto* child : current->children)
+					{
+						// Pending proxies of a lazy hierarchy do not know their data range yet
+						if (child == nullptr || child->pendingChunk.load(std::memory_order_acquire)) {
+							continue;
+						}
+
+						next.push_back(child);
+
+						const uint64_t size = static_cast<uint64_t>((std::max)(child->byteSize, int64_t(0)));
+						if (size == 0 || size > budget || pending.count(child) > 0) {
+							continue;
+						}
+
+						budget -= size;
+						hinted.push_back(child);
+					}
+				}
+
+				level.swap(next);
+			}
+
+			if (pending.size() + hinted.size() > policy.maxPendingHints) {
+				stats.expired += pending.size();
+				pending.clear();
+			}
+
+			for (const auto* child : hinted) {
+				pending.insert(child);
+				++stats.hintsIssued;
+				stats.bytesHinted += static_cast<uint64_t>(child->byteSize);
+			}
+		}
+
+		// The hints themselves are system calls and do not need the lock
+		for (const auto* child : hinted) {
+			hint(static_cast<uint64_t>(child->byteOffset), static_cast<uint64_t>(child->byteSize));
+		}
+	}
+
+	PrefetchStats Stats() const
+	{
+		std::lock_guard<std::mutex> lock(prefetch_mutex);
+		return stats;
+	}
+
+	void ResetStats()
+	{
+		std::lock_guard<std::mutex> lock(prefetch_mutex);
+		stats = PrefetchStats();
+		pending.clear();
+	}
+};
+
+#endif
@@ -0,0 +1,100 @@
+#pragma once
+#ifndef OCTREERAYPICK_H
+#define OCTREERAYPICK_H
+#include <cmath>
+#include <limits>
+#include <cstdint>
+#include <stdexcept>
+#include <algorithm>
+#include "../ThirdParty/PotreeConverter/Geometry.h"
+
+// Half line from origin along a unit direction
+struct Ray
+{
+	geometry::Vector3 origin;
+	geometry::Vector3 direction;
+
+	// The direction is normalized
+	Ray(const geometry::Vector3& origin, const geometry::Vector3& direction) : origin(origin)
+	{
+		const double length = std::sqrt(direction.x * direction.x + direction.y * direction.y + direction.z * direction.z);
+		if (!(length > 0)) {
+			throw std::invalid_argument("Ray direction cannot be zero");
+		}
+		this->direction = geometry::Vector3(direction.x / length, direction.y / length, direction.z / length);
+	}
+
+	// Ray from origin through target, e.g. from the camera through the clicked point on the near plane
+	static Ray Through(const geometry::Vector3& origin, const geometry::Vector3& target)
+	{
+		return Ray(origin, geometry::Vector3(target.x - origin.x, target.y - origin.y, target.z - origin.z));
+	}
+
+	geometry::Vector3 At(double distance) const
+	{
+		return geometry::Vector3(origin.x + direction.x * distance, origin.y + direction.y * distance, origin.z + direction.z * distance);
+	}
+};
+
+// Distances along the ray where it enters and leaves the box, slab test. entry is 0 if the origin lies within the box.
+// False if the ray misses the box
+inline bool IntersectRay(const Ray& ray, const geometry::BoundingBox& box, double& entry, double& exit)
+{
+	const double origin[3] = { ray.origin.x, ray.origin.y, ray.origin.z };
+	const double direction[3] = { ray.direction.x, ray.direction.y, ray.direction.z };
+	const double min[3] = { box.min.x, box.min.y, box.min.z };
+	const double max[3] = { box.max.x, box.max.y, box.max.z };
+
+	entry = 0.0;
+	exit = (std::numeric_limits<double>::max)();
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		if (direction[axis] == 0)
+		{
+			if (origin[axis] < min[axis] || origin[axis] > max[axis]) {
+				return false;
+			}
+			continue;
+		}
+
+		// Not near/far, which windows.h defines as macros
+		double enter = (min[axis] - origin[axis]) / direction[axis];
+		double leave = (max[axis] - origin[axis]) / direction[axis];
+		if (enter > leave) {
+			std::swap(enter, leave);
+		}
+
+		entry = (std::max)(entry, enter);
+		exit = (std::min)(exit, leave);
+		if (entry > exit) {
+			return false;
+		}
+	}
+	return true;
+}
+
+struct PickOptions
+{
+	double radius = 0.1; // Points farther from the ray are not picked
+	double maxDistance = (std::numeric_limits<double>::max)(); // Points farther along the ray are not picked
+	int maxLevel = (std::numeric_limits<int>::max)(); // Deeper nodes are not loaded, limits the latency of interactive picking
+};
+
+// The picked point is the one within the pick radius which comes first along the ray
+template<typename Node>
+struct PickResult
+{
+	Node node{};
+	uint32_t pointIndex = 0; // Index of the point within the node's data
+	geometry::Vector3 position;
+	double distance = (std::numeric_limits<double>::max)(); // Along the ray
+	double distanceToRay = 0.0;
+	size_t nodesLoaded = 0;
+
+	bool hit() const
+	{
+		return distance != (std::numeric_limits<double>::max)();
+	}
+};
+
+#endif
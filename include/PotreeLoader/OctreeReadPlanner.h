@@ -0,0 +1,138 @@
+#pragma once
+#ifndef OCTREEREADPLANNER_H
+#define OCTREEREADPLANNER_H
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include "OctreeAsyncReader.h"
+
+struct ReadPlanOptions
+{
+	uint64_t maxGap = 64 * 1024;             // Ranges separated by at most this many unused bytes are merged
+	uint64_t maxReadSize = 8 * 1024 * 1024;  // Merged reads do not grow beyond this size. Single larger ranges are read as they are
+};
+
+struct ScanOptions
+{
+	uint64_t chunkSize = 32 * 1024 * 1024; // Size of the sequential reads. Two chunks are held in memory at a time
+};
+
+// Part of a merged read that belongs to one requested range
+struct PlannedSlice
+{
+	size_t id;             // Id of the AsyncReadRequest this slice answers
+	uint64_t offsetInRead; // Start of the slice relative to the merged read
+	uint64_t byteSize;
+};
+
+// One merged read covering the slices [firstSlice, firstSlice + sliceCount)
+struct PlannedRead
+{
+	uint64_t byteOffset;
+	uint64_t byteSize;
+	size_t firstSlice;
+	size_t sliceCount;
+};
+
+struct ReadPlanStats
+{
+	uint64_t bytesRead = 0; // Bytes covered by the merged reads, including gaps
+	uint64_t bytesUsed = 0; // Bytes of the requested ranges
+	size_t rangeCount = 0;
+	size_t readCount = 0;
+
+	// Bytes read per byte used. 1.0 means no gap bytes were read
+	double Amplification() const
+	{
+		return bytesUsed > 0 ? static_cast<double>(bytesRead) / static_cast<double>(bytesUsed) : 1.0;
+	}
+};
+
+// Sorts byte ranges by offset and merges neighbours into large reads
+struct ReadPlan
+{
+	std::vector<PlannedRead> reads;
+	std::vector<PlannedSlice> slices;
+	ReadPlanStats stats;
+
+	static ReadPlan Create(std::vector<AsyncReadRequest> ranges, const ReadPlanOptions& options = ReadPlanOptions())
+	{
+		ReadPlan plan;
+		plan.stats.rangeCount = ranges.size();
+
+		std::sort(ranges.begin(), ranges.end(), [](const AsyncReadRequest& a, const AsyncReadRequest& b) {
+			return a.byteOffset < b.byteOffset;
+			});
+
+		plan.slices.reserve(ranges.size());
+
+		for (const auto& range : ranges)
+		{
+			plan.stats.bytesUsed += range.byteSize;
+
+			if (!plan.reads.empty())
+			{
+				auto& current = plan.reads.back();
+				const uint64_t currentEnd = current.byteOffset + current.byteSize;
+				const uint64_t mergedEnd = (std::max)(currentEnd, range.byteOffset + range.byteSize);
+
+				// Overlapping ranges are always merged, otherwise only small gaps within the size limit
+				const bool overlaps = range.byteOffset < currentEnd;
+				const bool smallGap = range.byteOffset - (std::min)(range.byteOffset, currentEnd) <= options.maxGap;
+				const bool fits = mergedEnd - current.byteOffset <= options.maxReadSize;
+
+				if (overlaps || (smallGap && fits))
+				{
+					current.byteSize = mergedEnd - current.byteOffset;
+					current.sliceCount++;
+					plan.slices.push_back({ range.id, range.byteOffset - current.byteOffset, range.byteSize });
+					continue;
+				}
+			}
+
+			plan.reads.push_back({ range.byteOffset, range.byteSize, plan.slices.size(), 1 });
+			plan.slices.push_back({ range.id, 0, range.byteSize });
+		}
+
+		for (const auto& read : plan.reads) {
+			plan.stats.bytesRead += read.byteSize;
+		}
+		plan.stats.readCount = plan.reads.size();
+
+		return plan;
+	}
+
+	// Requests for the merged reads. The request id is the index into 'reads'
+	std::vector<AsyncReadRequest> ReadRequests() const
+	{
+		std::vector<AsyncReadRequest> requests;
+		requests.reserve(reads.size());
+
+		for (size_t i = 0; i < reads.size(); ++i) {
+			requests.push_back({ reads[i].byteOffset, reads[i].byteSize, i });
+		}
+
+		return requests;
+	}
+
+	// Executes the plan and calls the callback once per requested range with a pointer into the merged read buffer.
+	// Ranges which reach beyond the end of the file are delivered truncated.
+	// Reader is anything with a Read(requests, callback, options) method, e.g. OctreeAsyncReader or a ByteSource
+	template<class Reader>
+	void Execute(const Reader& reader, const AsyncReadCallback& callback, const AsyncReadOptions& options = AsyncReadOptions()) const
+	{
+		reader.Read(ReadRequests(), [this, &callback](size_t readIndex, const uint8_t* data, size_t size) {
+			const auto& read = reads[readIndex];
+
+			for (size_t i = read.firstSlice; i < read.firstSlice + read.sliceCount; ++i)
+			{
+				const auto& slice = slices[i];
+				const uint64_t start = (std::min)(slice.offsetInRead, static_cast<uint64_t>(size));
+				const uint64_t sliceSize = (std::min)(slice.byteSize, size - start);
+				callback(slice.id, data + start, static_cast<size_t>(sliceSize));
+			}
+			}, options);
+	}
+};
+
+#endif
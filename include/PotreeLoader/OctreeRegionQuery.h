@@ -0,0 +1,314 @@
+#pragma once
+#ifndef OCTREEREGIONQUERY_H
+#define OCTREEREGIONQUERY_H
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+#include <stdexcept>
+#include "../ThirdParty/PotreeConverter/Geometry.h"
+#include "OctreeTraversal.h"
+#include "OctreeNodeBounds.h" // POTREELOADER_HAS_SSE2
+
+// How a node's bounding box relates to a query region
+enum class Containment : uint8_t {
+	Outside = 0,
+	Partial = 1, // Only some of the node's points may lie within the region, they need a point test
+	Inside = 2,  // All points of the node lie within the region
+};
+
+// Axis aligned box region
+class BoxRegion
+{
+public:
+	geometry::BoundingBox box;
+
+	explicit BoxRegion(const geometry::BoundingBox& box) : box(box) {}
+
+	Containment Classify(const geometry::BoundingBox& node) const
+	{
+		if (node.max.x < box.min.x || node.max.y < box.min.y || node.max.z < box.min.z ||
+			node.min.x > box.max.x || node.min.y > box.max.y || node.min.z > box.max.z) {
+			return Containment::Outside;
+		}
+
+		if (node.min.x >= box.min.x && node.min.y >= box.min.y && node.min.z >= box.min.z &&
+			node.max.x <= box.max.x && node.max.y <= box.max.y && node.max.z <= box.max.z) {
+			return Containment::Inside;
+		}
+
+		return Containment::Partial;
+	}
+
+	bool Contains(double x, double y, double z) const
+	{
+		return x >= box.min.x && x <= box.max.x && y >= box.min.y && y <= box.max.y && z >= box.min.z && z <= box.max.z;
+	}
+
+	// inside[i] is set to 1 for the points within the region, 0 otherwise
+	void ContainsPoints(const double* x, const double* y, const double* z, size_t count, uint8_t* inside) const
+	{
+		size_t i = 0;
+
+#if POTREELOADER_HAS_SSE2
+		const __m128d minX = _mm_set1_pd(box.min.x), minY = _mm_set1_pd(box.min.y), minZ = _mm_set1_pd(box.min.z);
+		const __m128d maxX = _mm_set1_pd(box.max.x), maxY = _mm_set1_pd(box.max.y), maxZ = _mm_set1_pd(box.max.z);
+		for (; i + 2 <= count; i += 2)
+		{
+			const __m128d px = _mm_loadu_pd(x + i), py = _mm_loadu_pd(y + i), pz = _mm_loadu_pd(z + i);
+			__m128d mask = _mm_and_pd(_mm_cmpge_pd(px, minX), _mm_cmple_pd(px, maxX));
+			mask = _mm_and_pd(mask, _mm_and_pd(_mm_cmpge_pd(py, minY), _mm_cmple_pd(py, maxY)));
+			mask = _mm_and_pd(mask, _mm_and_pd(_mm_cmpge_pd(pz, minZ), _mm_cmple_pd(pz, maxZ)));
+
+			const int bits = _mm_movemask_pd(mask);
+			inside[i] = static_cast<uint8_t>(bits & 1);
+			inside[i + 1] = static_cast<uint8_t>(bits >> 1);
+		}
+#endif
+		for (; i < count; ++i) {
+			inside[i] = Contains(x[i], y[i], z[i]) ? 1 : 0;
+		}
+	}
+};
+
+// Box with arbitrary orientation: center, three orthonormal axes and the half extents along them
+class OrientedBoxRegion
+{
+public:
+	geometry::Vector3 center;
+	geometry::Vector3 axes[3];
+	double halfExtents[3];
+
+	// The axes are normalized, they have to be perpendicular to each other
+	OrientedBoxRegion(const geometry::Vector3& center, const geometry::Vector3& halfExtents,
+		const geometry::Vector3& axisX, const geometry::Vector3& axisY, const geometry::Vector3& axisZ)
+		: center(center), axes{ Normalized(axisX), Normalized(axisY), Normalized(axisZ) }, halfExtents{ halfExtents.x, halfExtents.y, halfExtents.z }
+	{
+		for (int i = 0; i < 3; ++i)
+		{
+			if (std::abs(Dot(axes[i], axes[(i + 1) % 3])) > 1e-6) {
+				throw std::invalid_argument("The axes of an oriented box region have to be perpendicular");
+			}
+		}
+
+		if (!(halfExtents.x >= 0 && halfExtents.y >= 0 && halfExtents.z >= 0)) {
+			throw std::invalid_argument("The half extents of an oriented box region cannot be negative");
+		}
+	}
+
+	// Box rotated by angle (radians, counterclockwise) about the vertical axis through its center, e.g. a clip box in map view
+	static OrientedBoxRegion RotatedAboutZ(const geometry::Vector3& center, const geometry::Vector3& halfExtents, double angle)
+	{
+		const double c = std::cos(angle);
+		const double s = std::sin(angle);
+		return OrientedBoxRegion(center, halfExtents, { c, s, 0 }, { -s, c, 0 }, { 0, 0, 1 });
+	}
+
+	// Inside is exact: the box is the intersection of three slabs, a node is inside if its projection lies within each slab.
+	// Outside is tested on the six face axes of both boxes, so a node close to an edge of the region may be reported as
+	// Partial although no point of it can lie within the region. Its points are then tested and all fail
+	Containment Classify(const geometry::BoundingBox& node) const
+	{
+		const double nodeCenter[3] = { (node.min.x + node.max.x) / 2, (node.min.y + node.max.y) / 2, (node.min.z + node.max.z) / 2 };
+		const double nodeHalf[3] = { (node.max.x - node.min.x) / 2, (node.max.y - node.min.y) / 2, (node.max.z - node.min.z) / 2 };
+		const double toNode[3] = { nodeCenter[0] - center.x, nodeCenter[1] - center.y, nodeCenter[2] - center.z };
+
+		// Region axes
+		bool inside = true;
+		for (int i = 0; i < 3; ++i)
+		{
+			const double distance = std::abs(toNode[0] * axes[i].x + toNode[1] * axes[i].y + toNode[2] * axes[i].z);
+			const double radius = nodeHalf[0] * std::abs(axes[i].x) + nodeHalf[1] * std::abs(axes[i].y) + nodeHalf[2] * std::abs(axes[i].z);
+			if (distance > halfExtents[i] + radius) {
+				return Containment::Outside;
+			}
+			inside &= distance + radius <= halfExtents[i];
+		}
+
+		if (inside) {
+			return Containment::Inside;
+		}
+
+		// World axes, i.e. the node's faces
+		for (int k = 0; k < 3; ++k)
+		{
+			double radius = 0;
+			for (int i = 0; i < 3; ++i) {
+				radius += halfExtents[i] * std::abs(Component(axes[i], k));
+			}
+			if (std::abs(toNode[k]) > nodeHalf[k] + radius) {
+				return Containment::Outside;
+			}
+		}
+
+		return Containment::Partial;
+	}
+
+	bool Contains(double x, double y, double z) const
+	{
+		const double dx = x - center.x, dy = y - center.y, dz = z - center.z;
+		for (int i = 0; i < 3; ++i)
+		{
+			if (std::abs(dx * axes[i].x + dy * axes[i].y + dz * axes[i].z) > halfExtents[i]) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// inside[i] is set to 1 for the points within the region, 0 otherwise
+	void ContainsPoints(const double* x, const double* y, const double* z, size_t count, uint8_t* inside) const
+	{
+		size_t i = 0;
+
+#if POTREELOADER_HAS_SSE2
+		const __m128d signBits = _mm_set1_pd(-0.0);
+		const __m128d cx = _mm_set1_pd(center.x), cy = _mm_set1_pd(center.y), cz = _mm_set1_pd(center.z);
+		for (; i + 2 <= count; i += 2)
+		{
+			const __m128d dx = _mm_sub_pd(_mm_loadu_pd(x + i), cx);
+			const __m128d dy = _mm_sub_pd(_mm_loadu_pd(y + i), cy);
+			const __m128d dz = _mm_sub_pd(_mm_loadu_pd(z + i), cz);
+
+			__m128d mask = _mm_castsi128_pd(_mm_set1_epi32(-1));
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				__m128d local = _mm_mul_pd(dx, _mm_set1_pd(axes[axis].x));
+				local = _mm_add_pd(local, _mm_mul_pd(dy, _mm_set1_pd(axes[axis].y)));
+				local = _mm_add_pd(local, _mm_mul_pd(dz, _mm_set1_pd(axes[axis].z)));
+				mask = _mm_and_pd(mask, _mm_cmple_pd(_mm_andnot_pd(signBits, local), _mm_set1_pd(halfExtents[axis])));
+			}
+
+			const int bits = _mm_movemask_pd(mask);
+			inside[i] = static_cast<uint8_t>(bits & 1);
+			inside[i + 1] = static_cast<uint8_t>(bits >> 1);
+		}
+#endif
+		for (; i < count; ++i) {
+			inside[i] = Contains(x[i], y[i], z[i]) ? 1 : 0;
+		}
+	}
+
+private:
+	static double Dot(const geometry::Vector3& a, const geometry::Vector3& b)
+	{
+		return a.x * b.x + a.y * b.y + a.z * b.z;
+	}
+
+	static double Component(const geometry::Vector3& v, int axis)
+	{
+		return axis == 0 ? v.x : axis == 1 ? v.y : v.z;
+	}
+
+	static geometry::Vector3 Normalized(const geometry::Vector3& v)
+	{
+		const double length = std::sqrt(Dot(v, v));
+		if (!(length > 0)) {
+			throw std::invalid_argument("The axes of an oriented box region cannot be zero");
+		}
+		return geometry::Vector3(v.x / length, v.y / length, v.z / length);
+	}
+};
+
+// A node found by a region query
+template<typename Node>
+struct RegionNode
+{
+	Node node;
+	Containment containment;
+};
+
+namespace octree_region
+{
+	template<typename Node>
+	geometry::BoundingBox Bounds(const Node& node)
+	{
+		if constexpr (requires { node->bounds(); }) {
+			return node->bounds();
+		}
+		else {
+			return node.boundingBox();
+		}
+	}
+}
+
+// Calls callback(node, containment) for every node within levels whose box is not outside the region, depth-first pre-order.
+// Subtrees of outside nodes are skipped. Descendants of an inside node are inside as well and are not classified again.
+// Nodes are classified by their bounds before they are prepared, so outside proxies of a lazy hierarchy load no chunks.
+// Works with any node type of TraverseDepthFirst with a bounds() or boundingBox() and any region with Classify
+template<typename Node, typename Region, typename Callback>
+void QueryRegion(const Node& root, const Region& region, Callback&& callback, const LevelRange& levels = LevelRange())
+{
+	// Level of the inside node whose subtree the traversal is in, -1 if none.
+	// In pre-order the subtree is left with the first node which is not deeper than the inside node
+	int insideLevel = -1;
+
+	TraverseDepthFirstDeferred(root, [&](const Node& node, int level) {
+		if (level > levels.maxLevel) {
+			return TraversalAction::SkipChildren;
+		}
+		if (level <= insideLevel) {
+			insideLevel = -1;
+		}
+
+		Containment containment = Containment::Inside;
+		if (insideLevel < 0)
+		{
+			containment = region.Classify(octree_region::Bounds(node));
+			if (containment == Containment::Outside) {
+				return TraversalAction::SkipChildren;
+			}
+			if (containment == Containment::Inside) {
+				insideLevel = level;
+			}
+		}
+
+		if (levels.contains(level))
+		{
+			OctreeTraversalTraits<Node>::Prepare(node);
+			callback(node, containment);
+		}
+		return level == levels.maxLevel ? TraversalAction::SkipChildren : TraversalAction::Continue;
+	});
+}
+
+// Indices of the points of a node which lie within the region, appended to indices. Returns their count.
+// Points are records of bytesPerPoint bytes with int32 xyz at positionOffset, coordinates are scale * xyz + offset.
+// Positions are decoded in blocks into coordinate arrays, which the region tests with SIMD
+template<typename Region>
+size_t SelectPointsInRegion(const Region& region, const uint8_t* data, size_t pointCount, size_t bytesPerPoint, size_t positionOffset,
+	const geometry::Vector3& scale, const geometry::Vector3& offset, std::vector<uint32_t>& indices)
+{
+	constexpr size_t blockSize = 256;
+	double x[blockSize], y[blockSize], z[blockSize];
+	uint8_t inside[blockSize];
+
+	const size_t previousSize = indices.size();
+	for (size_t start = 0; start < pointCount; start += blockSize)
+	{
+		const size_t n = (std::min)(pointCount - start, blockSize);
+		for (size_t i = 0; i < n; ++i)
+		{
+			int32_t position[3];
+			memcpy(position, data + (start + i) * bytesPerPoint + positionOffset, sizeof(position));
+			x[i] = position[0] * scale.x + offset.x;
+			y[i] = position[1] * scale.y + offset.y;
+			z[i] = position[2] * scale.z + offset.z;
+		}
+
+		region.ContainsPoints(x, y, z, n, inside);
+
+		for (size_t i = 0; i < n; ++i)
+		{
+			if (inside[i]) {
+				indices.push_back(static_cast<uint32_t>(start + i));
+			}
+		}
+	}
+
+	return indices.size() - previousSize;
+}
+
+#endif
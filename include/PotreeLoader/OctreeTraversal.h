@@ -0,0 +1,376 @@
+#pragma once
+#ifndef OCTREETRAVERSAL_H
+#define OCTREETRAVERSAL_H
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <utility>
+#include <iterator>
+#include <concepts>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include "OctreeNodeKey.h"
+
+// What a traversal does after visiting a node. Visitors may also return void, which continues
+enum class TraversalAction {
+	Continue = 0,
+	SkipChildren = 1, // Do not descend into the node's subtree
+	Stop = 2,         // End the traversal
+};
+
+// Inclusive range of node levels a traversal visits
+struct LevelRange
+{
+	int minLevel = 0;
+	int maxLevel = (std::numeric_limits<int>::max)();
+
+	// Levels 0 to maxLevel
+	static LevelRange UpTo(int maxLevel)
+	{
+		return { 0, maxLevel };
+	}
+
+	bool contains(int level) const
+	{
+		return level >= minLevel && level <= maxLevel;
+	}
+};
+
+// How a traversal moves through a node type. Works for OctreeGeometryNode* (children vector, expand() is called
+// before a node is visited) and for handles with level(), childCount() and child(n) like OctreeTableNode.
+// Specialize it for other node types
+template<typename Node>
+struct OctreeTraversalTraits
+{
+	static void Prepare(const Node& node)
+	{
+		if constexpr (requires { node->expand(); }) {
+			node->expand();
+		}
+	}
+
+	static int Level(const Node& node)
+	{
+		if constexpr (requires { node->level; }) {
+			return static_cast<int>(node->level);
+		}
+		else {
+			return static_cast<int>(node.level());
+		}
+	}
+
+	// Writes the children in octant order, returns their count
+	static int Children(const Node& node, Node (&children)[8])
+	{
+		int count = 0;
+		if constexpr (requires { node->children; })
+		{
+			for (const auto& child : node->children)
+			{
+				if (child != nullptr) {
+					children[count++] = child;
+				}
+			}
+		}
+		else
+		{
+			const int childCount = node.childCount();
+			for (; count < childCount; ++count) {
+				children[count] = node.child(count);
+			}
+		}
+		return count;
+	}
+};
+
+namespace octree_traversal
+{
+	// Deepest tree a traversal handles without allocating, the deepest tree node keys can describe
+	constexpr int maxDepth = OctreeNodeKey::maxLevel + 1;
+
+	template<typename Function, typename Node>
+	TraversalAction Invoke(Function& function, const Node& node, int level)
+	{
+		if constexpr (std::is_invocable_v<Function&, const Node&, int>)
+		{
+			using Result = std::invoke_result_t<Function&, const Node&, int>;
+			static_assert(std::is_void_v<Result> || std::is_same_v<Result, TraversalAction>, "Traversal visitors return void or TraversalAction");
+
+			if constexpr (std::is_void_v<Result>) {
+				function(node, level);
+				return TraversalAction::Continue;
+			}
+			else {
+				return function(node, level);
+			}
+		}
+		else
+		{
+			using Result = std::invoke_result_t<Function&, const Node&>;
+			static_assert(std::is_void_v<Result> || std::is_same_v<Result, TraversalAction>, "Traversal visitors return void or TraversalAction");
+
+			if constexpr (std::is_void_v<Result>) {
+				function(node);
+				return TraversalAction::Continue;
+			}
+			else {
+				return function(node);
+			}
+		}
+	}
+
+	inline void ThrowTooDeep()
+	{
+		throw std::out_of_range("Octree traversal reached a node deeper than level " + std::to_string(maxDepth - 1));
+	}
+}
+
+namespace octree_traversal
+{
+	// Depth-first pre-order, see TraverseDepthFirst. Without PrepareBeforeVisit a node is prepared only when its children are entered
+	template<bool PrepareBeforeVisit, typename Node, typename Visit>
+	bool DepthFirst(const Node& root, Visit& visit)
+	{
+		using Traits = OctreeTraversalTraits<Node>;
+
+		struct Entry
+		{
+			Node node;
+			int level;
+		};
+
+		// A stack holds at most 7 pending siblings per level above the current node plus 8 children
+		Entry stack[8 * maxDepth];
+		size_t size = 0;
+		stack[size++] = { root, Traits::Level(root) };
+
+		Node children[8];
+		while (size > 0)
+		{
+			const Entry entry = stack[--size];
+			if constexpr (PrepareBeforeVisit) {
+				Traits::Prepare(entry.node);
+			}
+
+			const TraversalAction action = Invoke(visit, entry.node, entry.level);
+			if (action == TraversalAction::Stop) {
+				return false;
+			}
+			if (action == TraversalAction::SkipChildren) {
+				continue;
+			}
+
+			if constexpr (!PrepareBeforeVisit) {
+				Traits::Prepare(entry.node);
+			}
+
+			const int count = Traits::Children(entry.node, children);
+			if (size + static_cast<size_t>(count) > std::size(stack)) {
+				ThrowTooDeep();
+			}
+
+			// Reverse order, so children are visited in octant order
+			for (int n = count; n-- > 0;) {
+				stack[size++] = { children[n], entry.level + 1 };
+			}
+		}
+
+		return true;
+	}
+}
+
+// Depth-first pre-order: a node before its children, children in octant order. visit(node, level) or visit(node)
+// returns void or a TraversalAction. Iterative with a fixed size stack, so it neither recurses nor allocates.
+// Levels are the nodes' own levels. Returns false if a visitor stopped the traversal
+template<typename Node, typename Visit>
+bool TraverseDepthFirst(const Node& root, Visit&& visit)
+{
+	return octree_traversal::DepthFirst<true>(root, visit);
+}
+
+// Like TraverseDepthFirst, but a node is prepared only once its children are entered, not before its visit.
+// A visitor which decides by the node's bounds, which the key gives, thus skips subtrees of a lazy hierarchy
+// without loading their chunks. Visitors needing a node's content call OctreeTraversalTraits<Node>::Prepare themselves
+template<typename Node, typename Visit>
+bool TraverseDepthFirstDeferred(const Node& root, Visit&& visit)
+{
+	return octree_traversal::DepthFirst<false>(root, visit);
+}
+
+// Depth-first with a pre-order visit and a post-order leave(node, level), called after the node's subtree.
+// leave is called for every visited node, also when visit skipped its children. Without allocations like above
+template<typename Node, typename Visit, typename Leave> requires (!std::same_as<std::remove_cvref_t<Leave>, LevelRange>)
+bool TraverseDepthFirst(const Node& root, Visit&& visit, Leave&& leave)
+{
+	using Traits = OctreeTraversalTraits<Node>;
+
+	struct Frame
+	{
+		Node node;
+		Node children[8];
+		int level;
+		int childCount;
+		int next;
+	};
+
+	Frame stack[octree_traversal::maxDepth];
+	int depth = 0;
+
+	// Visits a node and pushes its frame. False if the traversal stops
+	auto enter = [&](const Node& node, int level) {
+		Traits::Prepare(node);
+
+		const TraversalAction action = octree_traversal::Invoke(visit, node, level);
+		if (action == TraversalAction::Stop) {
+			return false;
+		}
+
+		Frame& frame = stack[depth++];
+		frame.node = node;
+		frame.level = level;
+		frame.childCount = action == TraversalAction::SkipChildren ? 0 : Traits::Children(node, frame.children);
+		frame.next = 0;
+		return true;
+	};
+
+	if (!enter(root, Traits::Level(root))) {
+		return false;
+	}
+
+	while (depth > 0)
+	{
+		Frame& frame = stack[depth - 1];
+		if (frame.next < frame.childCount)
+		{
+			if (depth == octree_traversal::maxDepth) {
+				octree_traversal::ThrowTooDeep();
+			}
+			if (!enter(frame.children[frame.next++], frame.level + 1)) {
+				return false;
+			}
+			continue;
+		}
+
+		--depth;
+		if (octree_traversal::Invoke(leave, frame.node, frame.level) == TraversalAction::Stop) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Depth-first pre-order over the nodes within the level range. Nodes above levels.minLevel are passed without a visit,
+// nodes below levels.maxLevel are never reached, so a lazy hierarchy does not load their chunks.
+// A visitor returning SkipChildren prunes its subtree like above
+template<typename Node, typename Visit>
+bool TraverseDepthFirst(const Node& root, Visit&& visit, const LevelRange& levels)
+{
+	return TraverseDepthFirst(root, [&visit, &levels](const Node& node, int level) {
+		if (level > levels.maxLevel) {
+			return TraversalAction::SkipChildren;
+		}
+
+		if (level >= levels.minLevel)
+		{
+			const TraversalAction action = octree_traversal::Invoke(visit, node, level);
+			if (action != TraversalAction::Continue) {
+				return action;
+			}
+		}
+
+		return level == levels.maxLevel ? TraversalAction::SkipChildren : TraversalAction::Continue;
+	});
+}
+
+// Breadth-first: all nodes of a level before the next level, each level in name order.
+// The queue is the only allocation, pass it in to reuse it across traversals
+template<typename Node, typename Visit>
+bool TraverseBreadthFirst(const Node& root, Visit&& visit, std::vector<Node>& queue)
+{
+	using Traits = OctreeTraversalTraits<Node>;
+
+	queue.clear();
+	queue.push_back(root);
+
+	// Levels change at known queue positions, so they are not stored per node
+	int level = Traits::Level(root);
+	size_t levelEnd = 1;
+
+	Node children[8];
+	for (size_t i = 0; i < queue.size(); ++i)
+	{
+		if (i == levelEnd) {
+			++level;
+			levelEnd = queue.size();
+		}
+
+		const Node node = queue[i];
+		Traits::Prepare(node);
+
+		const TraversalAction action = octree_traversal::Invoke(visit, node, level);
+		if (action == TraversalAction::Stop) {
+			return false;
+		}
+		if (action == TraversalAction::SkipChildren) {
+			continue;
+		}
+
+		const int count = Traits::Children(node, children);
+		queue.insert(queue.end(), children, children + count);
+	}
+
+	return true;
+}
+
+template<typename Node, typename Visit>
+bool TraverseBreadthFirst(const Node& root, Visit&& visit)
+{
+	std::vector<Node> queue;
+	return TraverseBreadthFirst(root, std::forward<Visit>(visit), queue);
+}
+
+// Level by level: visitLevel(nodes, level) receives all nodes of one level at once, e.g. to process them in a batch.
+// Returning TraversalAction::SkipChildren ends the traversal after this level like Stop, but reports completion.
+// The nodes of the next level are collected and prepared after visitLevel returned
+template<typename Node, typename VisitLevel>
+bool TraverseLevels(const Node& root, VisitLevel&& visitLevel)
+{
+	using Traits = OctreeTraversalTraits<Node>;
+
+	std::vector<Node> current{ root };
+	std::vector<Node> next;
+	int level = Traits::Level(root);
+	Traits::Prepare(root);
+
+	Node children[8];
+	while (!current.empty())
+	{
+		const TraversalAction action = octree_traversal::Invoke(visitLevel, current, level);
+		if (action == TraversalAction::Stop) {
+			return false;
+		}
+		if (action == TraversalAction::SkipChildren) {
+			return true;
+		}
+
+		next.clear();
+		for (const Node& node : current)
+		{
+			const int count = Traits::Children(node, children);
+			for (int n = 0; n < count; ++n)
+			{
+				Traits::Prepare(children[n]);
+				next.push_back(children[n]);
+			}
+		}
+
+		current.swap(next);
+		++level;
+	}
+
+	return true;
+}
+
+#endif
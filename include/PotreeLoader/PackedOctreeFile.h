@@ -0,0 +1,152 @@
+#pragma once
+#ifndef PACKEDOCTREEFILE_H
+#define PACKEDOCTREEFILE_H
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <filesystem>
+#include "PlatformFile.h"
+
+// Position of one of the dataset files within a packed file
+struct PackedSection
+{
+	uint64_t offset = 0;
+	uint64_t size = 0;
+};
+
+// Header of a packed octree file, which holds metadata.json, hierarchy.bin and octree.bin of one dataset,
+// so a dataset takes one inode and one open instead of three.
+// Layout: 64 byte header, then the sections at the offsets stored in the header, each starting at a 4096 byte boundary.
+// Header: magic "POTRPACK", u32 version, u32 reserved, then offset and size (u64) of metadata, hierarchy and octree. Little endian
+struct PackedOctreeHeader
+{
+	static constexpr char magic[8] = { 'P', 'O', 'T', 'R', 'P', 'A', 'C', 'K' };
+	static constexpr uint32_t currentVersion = 1;
+	static constexpr uint64_t headerSize = 64;
+	static constexpr uint64_t sectionAlignment = 4096;
+
+	uint32_t version = currentVersion;
+	PackedSection metadata;
+	PackedSection hierarchy;
+	PackedSection octree;
+
+	void Serialize(uint8_t* target) const
+	{
+		auto put = [&target](uint64_t value, int bytes) {
+			for (int i = 0; i < bytes; ++i) {
+				*target++ = static_cast<uint8_t>(value >> (8 * i));
+			}
+		};
+
+		memset(target, 0, headerSize);
+		memcpy(target, magic, sizeof(magic));
+		target += sizeof(magic);
+		put(version, 4);
+		put(0, 4);
+
+		for (const auto* section : { &metadata, &hierarchy, &octree }) {
+			put(section->offset, 8);
+			put(section->size, 8);
+		}
+	}
+
+	static bool HasMagic(const uint8_t* source, size_t size)
+	{
+		return size >= sizeof(magic) && memcmp(source, magic, sizeof(magic)) == 0;
+	}
+
+	// Parses and validates the header against the size of the packed file
+	static PackedOctreeHeader Parse(const uint8_t* source, size_t size, uint64_t fileSize, const std::string& name)
+	{
+		if (size < headerSize || !HasMagic(source, size)) {
+			throw std::runtime_error("Not a packed octree file: " + name);
+		}
+
+		auto get = [&source](int bytes) {
+			uint64_t value = 0;
+			for (int i = 0; i < bytes; ++i) {
+				value |= static_cast<uint64_t>(*source++) << (8 * i);
+			}
+			return value;
+		};
+
+		source += sizeof(magic);
+
+		PackedOctreeHeader header;
+		header.version = static_cast<uint32_t>(get(4));
+		get(4);
+
+		if (header.version != currentVersion) {
+			throw std::runtime_error("Unsupported packed octree version " + std::to_string(header.version) + ": " + name);
+		}
+
+		for (auto* section : { &header.metadata, &header.hierarchy, &header.octree })
+		{
+			section->offset = get(8);
+			section->size = get(8);
+
+			if (section->offset > fileSize || section->size > fileSize - section->offset) {
+				throw std::runtime_error("Packed octree section reaches beyond the end of the file: " + name);
+			}
+		}
+
+		return header;
+	}
+
+	static PackedOctreeHeader Read(const PositionalFile& file, uint64_t fileSize, const std::string& name)
+	{
+		uint8_t buffer[headerSize];
+		const size_t bytes_read = file.readAt(0, headerSize, buffer);
+		return Parse(buffer, bytes_read, fileSize, name);
+	}
+
+	// Whether the file starts with the packed octree magic
+	static bool IsPackedFile(const std::string& path)
+	{
+		if (!std::filesystem::is_regular_file(path) || std::filesystem::file_size(path) < headerSize) {
+			return false;
+		}
+
+		uint8_t buffer[sizeof(magic)];
+		PositionalFile file(path);
+		return HasMagic(buffer, file.readAt(0, sizeof(buffer), buffer));
+	}
+};
+
+// Packs the three files of a dataset into one packed octree file. File contents are copied with copy_file_range on Linux,
+// so they never pass through user space
+inline PackedOctreeHeader PackOctreeFiles(const std::string& metadataPath, const std::string& hierarchyPath, const std::string& octreePath, const std::string& packedPath)
+{
+	const std::string* sources[] = { &metadataPath, &hierarchyPath, &octreePath };
+
+	PackedOctreeHeader header;
+	PackedSection* sections[] = { &header.metadata, &header.hierarchy, &header.octree };
+
+	uint64_t end = PackedOctreeHeader::headerSize;
+	for (int i = 0; i < 3; ++i)
+	{
+		// An empty section is not aligned, an aligned offset after the last written byte would lie beyond the end of the file
+		sections[i]->size = std::filesystem::file_size(*sources[i]);
+		sections[i]->offset = sections[i]->size == 0 ? end : (end + PackedOctreeHeader::sectionAlignment - 1) / PackedOctreeHeader::sectionAlignment * PackedOctreeHeader::sectionAlignment;
+		end = sections[i]->offset + sections[i]->size;
+	}
+
+	OutputFile packed(packedPath);
+
+	for (int i = 0; i < 3; ++i)
+	{
+		PositionalFile source(*sources[i]);
+		packed.copyFrom(source, 0, sections[i]->size, sections[i]->offset);
+	}
+
+	// The header goes last, so an interrupted pack is not mistaken for a valid file
+	uint8_t buffer[PackedOctreeHeader::headerSize];
+	header.Serialize(buffer);
+	packed.writeAt(0, buffer, sizeof(buffer));
+
+	return header;
+}
+
+#endif
@@ -0,0 +1,419 @@
+#pragma once
+#ifndef PLATFORMFILE_H
+#define PLATFORMFILE_H
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cerrno>
+#include <algorithm>
+#include <stdexcept>
+#include <system_error>
+
+#ifdef _WIN32
+	#include <winsock2.h> // Has to come before windows.h, see HttpByteSource.h
+	#include "windows.h"
+#else
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+#endif
+
+// Read-only file handle which reads at explicit offsets and never touches a shared file position.
+// A single handle can therefore be used by several threads at the same time
+class PositionalFile
+{
+public:
+#ifdef _WIN32
+	using NativeHandle = HANDLE;
+#else
+	using NativeHandle = int;
+#endif
+
+private:
+#ifdef _WIN32
+	NativeHandle handle = INVALID_HANDLE_VALUE;
+#else
+	NativeHandle handle = -1;
+#endif
+	bool bypasses_cache = false;
+
+public:
+	// With bypassCache the file is opened unbuffered (O_DIRECT, FILE_FLAG_NO_BUFFERING, F_NOCACHE).
+	// Offsets, sizes and target buffers of unbuffered reads have to be aligned to the device block size.
+	// If the file system refuses unbuffered access, the file is opened normally and BypassesCache() returns false
+	PositionalFile(const std::string& path, bool bypassCache = false)
+	{
+#ifdef _WIN32
+		if (bypassCache) {
+			handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_NO_BUFFERING, nullptr);
+			bypasses_cache = handle != INVALID_HANDLE_VALUE;
+		}
+		if (handle == INVALID_HANDLE_VALUE) {
+			handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		}
+		if (handle == INVALID_HANDLE_VALUE) {
+			throw std::runtime_error("Could not open file: " + path);
+		}
+#else
+	#ifdef O_DIRECT
+		if (bypassCache) {
+			handle = ::open(path.c_str(), O_RDONLY | O_CLOEXEC | O_DIRECT);
+			bypasses_cache = handle >= 0;
+		}
+	#endif
+		if (handle < 0) {
+			handle = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		}
+		if (handle < 0) {
+			throw std::runtime_error("Could not open file: " + path);
+		}
+	#if defined(__APPLE__)
+		if (bypassCache) {
+			bypasses_cache = ::fcntl(handle, F_NOCACHE, 1) == 0;
+		}
+	#endif
+#endif
+	}
+
+	PositionalFile(const PositionalFile&) = delete;
+	PositionalFile& operator=(const PositionalFile&) = delete;
+
+	~PositionalFile()
+	{
+#ifdef _WIN32
+		CloseHandle(handle);
+#else
+		::close(handle);
+#endif
+	}
+
+	NativeHandle native_handle() const
+	{
+		return handle;
+	}
+
+	bool BypassesCache() const
+	{
+		return bypasses_cache;
+	}
+
+	// Asks the OS to read the range into the page cache in the background. Returns false if hints are not supported
+	bool WillNeed(uint64_t byte_start, uint64_t byte_size) const
+	{
+#if !defined(_WIN32) && defined(POSIX_FADV_WILLNEED)
+		return ::posix_fadvise(handle, static_cast<off_t>(byte_start), static_cast<off_t>(byte_size), POSIX_FADV_WILLNEED) == 0;
+#else
+		(void)byte_start;
+		(void)byte_size;
+		return false;
+#endif
+	}
+
+	// Asks the OS to drop cached pages of the range. Used where unbuffered access is not available
+	void DropCache(uint64_t byte_start, uint64_t byte_size) const
+	{
+#if !defined(_WIN32) && defined(POSIX_FADV_DONTNEED)
+		::posix_fadvise(handle, static_cast<off_t>(byte_start), static_cast<off_t>(byte_size), POSIX_FADV_DONTNEED);
+#else
+		(void)byte_start;
+		(void)byte_size;
+#endif
+	}
+
+	// Reads up to byte_size bytes starting at byte_start. Returns the number of bytes actually read, which is less only at the end
+	// of the file. Throws std::system_error if the read fails
+	size_t readAt(uint64_t byte_start, uint64_t byte_size, uint8_t* target) const
+	{
+		size_t bytes_read = 0;
+
+		while (bytes_read < byte_size)
+		{
+			const uint64_t position = byte_start + bytes_read;
+			const uint64_t remaining = byte_size - bytes_read;
+#ifdef _WIN32
+			DWORD chunk = static_cast<DWORD>((std::min)(remaining, uint64_t(1) << 30));
+			DWORD chunk_read = 0;
+			OVERLAPPED overlapped = {};
+			overlapped.Offset = static_cast<DWORD>(position & 0xFFFFFFFF);
+			overlapped.OffsetHigh = static_cast<DWORD>(position >> 32);
+
+			if (!ReadFile(handle, target + bytes_read, chunk, &chunk_read, &overlapped)) {
+				const DWORD error = GetLastError();
+				if (error == ERROR_HANDLE_EOF) {
+					break;
+				}
+				throw std::system_error(static_cast<int>(error), std::system_category(), "Positional read failed");
+			}
+			if (chunk_read == 0) {
+				break;
+			}
+#else
+			const ssize_t chunk_read = ::pread(handle, target + bytes_read, static_cast<size_t>(remaining), static_cast<off_t>(position));
+
+			if (chunk_read < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				throw std::system_error(errno, std::generic_category(), "Positional read failed");
+			}
+			if (chunk_read == 0) {
+				break;
+			}
+#endif
+			bytes_read += static_cast<size_t>(chunk_read);
+		}
+
+		return bytes_read;
+	}
+};
+
+// Read-only memory mapping of a whole file. The mapping stays valid as long as the object lives
+class MappedFile
+{
+	const uint8_t* mapped = nullptr;
+	size_t mapped_size = 0;
+#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = nullptr;
+#endif
+
+public:
+	MappedFile(const std::string& path)
+	{
+#ifdef _WIN32
+		file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) {
+			throw std::runtime_error("Could not open file: " + path);
+		}
+
+		LARGE_INTEGER size;
+		GetFileSizeEx(file, &size);
+		mapped_size = static_cast<size_t>(size.QuadPart);
+
+		// Empty files can not be mapped
+		if (mapped_size == 0) {
+			return;
+		}
+
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping == nullptr) {
+			CloseHandle(file);
+			throw std::runtime_error("Could not create file mapping: " + path);
+		}
+
+		mapped = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+		if (mapped == nullptr) {
+			CloseHandle(mapping);
+			CloseHandle(file);
+			throw std::runtime_error("Could not map file: " + path);
+		}
+#else
+		int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0) {
+			throw std::runtime_error("Could not open file: " + path);
+		}
+
+		struct stat file_stat;
+		if (::fstat(fd, &file_stat) != 0) {
+			::close(fd);
+			throw std::runtime_error("Could not stat file: " + path);
+		}
+		mapped_size = static_cast<size_t>(file_stat.st_size);
+
+		// Empty files can not be mapped
+		if (mapped_size == 0) {
+			::close(fd);
+			return;
+		}
+
+		void* address = ::mmap(nullptr, mapped_size, PROT_READ, MAP_SHARED, fd, 0);
+		::close(fd); // The mapping keeps its own reference to the file
+
+		if (address == MAP_FAILED) {
+			throw std::runtime_error("Could not map file: " + path);
+		}
+		mapped = static_cast<const uint8_t*>(address);
+#endif
+	}
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	~MappedFile()
+	{
+#ifdef _WIN32
+		if (mapped != nullptr) UnmapViewOfFile(mapped);
+		if (mapping != nullptr) CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+		if (mapped != nullptr) ::munmap(const_cast<uint8_t*>(mapped), mapped_size);
+#endif
+	}
+
+	const uint8_t* data() const
+	{
+		return mapped;
+	}
+
+	// Size of a virtual memory page, queried once
+	static uint64_t PageSize()
+	{
+		static const uint64_t page = []() -> uint64_t {
+#ifdef _WIN32
+			SYSTEM_INFO info;
+			GetSystemInfo(&info);
+			return info.dwPageSize;
+#else
+			const long size = ::sysconf(_SC_PAGESIZE);
+			return size > 0 ? static_cast<uint64_t>(size) : 4096;
+#endif
+		}();
+		return page;
+	}
+
+	// Asks the OS to page in the range in the background. Returns false if hints are not supported
+	bool WillNeed(uint64_t byte_start, uint64_t byte_size) const
+	{
+		if (mapped == nullptr || byte_start >= mapped_size) {
+			return false;
+		}
+
+		// Hints have to start on a page boundary
+		const uint64_t page = PageSize();
+		const uint64_t start = byte_start / page * page;
+		const uint64_t end = (std::min)(byte_start + byte_size, static_cast<uint64_t>(mapped_size));
+#ifdef _WIN32
+		WIN32_MEMORY_RANGE_ENTRY range;
+		range.VirtualAddress = const_cast<uint8_t*>(mapped + start);
+		range.NumberOfBytes = static_cast<SIZE_T>(end - start);
+		return PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0) != 0;
+#else
+		return ::madvise(const_cast<uint8_t*>(mapped + start), static_cast<size_t>(end - start), MADV_WILLNEED) == 0;
+#endif
+	}
+
+	size_t size() const
+	{
+		return mapped_size;
+	}
+};
+
+// Write-only file handle for building files at explicit offsets, e.g. packed octree containers.
+// The file is created or truncated on open
+class OutputFile
+{
+	std::string file_path;
+#ifdef _WIN32
+	HANDLE handle = INVALID_HANDLE_VALUE;
+#else
+	int handle = -1;
+#endif
+
+public:
+	OutputFile(const std::string& path) : file_path(path)
+	{
+#ifdef _WIN32
+		handle = CreateFileA(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (handle == INVALID_HANDLE_VALUE) {
+			throw std::runtime_error("Could not create file: " + path);
+		}
+#else
+		handle = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+		if (handle < 0) {
+			throw std::runtime_error("Could not create file: " + path);
+		}
+#endif
+	}
+
+	OutputFile(const OutputFile&) = delete;
+	OutputFile& operator=(const OutputFile&) = delete;
+
+	~OutputFile()
+	{
+#ifdef _WIN32
+		CloseHandle(handle);
+#else
+		::close(handle);
+#endif
+	}
+
+	void writeAt(uint64_t byte_start, const uint8_t* source, uint64_t byte_size)
+	{
+		uint64_t bytes_written = 0;
+
+		while (bytes_written < byte_size)
+		{
+			const uint64_t position = byte_start + bytes_written;
+			const uint64_t remaining = byte_size - bytes_written;
+#ifdef _WIN32
+			DWORD chunk = static_cast<DWORD>((std::min)(remaining, uint64_t(1) << 30));
+			DWORD chunk_written = 0;
+			OVERLAPPED overlapped = {};
+			overlapped.Offset = static_cast<DWORD>(position & 0xFFFFFFFF);
+			overlapped.OffsetHigh = static_cast<DWORD>(position >> 32);
+
+			if (!WriteFile(handle, source + bytes_written, chunk, &chunk_written, &overlapped) || chunk_written == 0) {
+				throw std::runtime_error("Could not write file: " + file_path);
+			}
+#else
+			const ssize_t chunk_written = ::pwrite(handle, source + bytes_written, static_cast<size_t>(remaining), static_cast<off_t>(position));
+
+			if (chunk_written < 0 && errno == EINTR) {
+				continue;
+			}
+			if (chunk_written <= 0) {
+				throw std::runtime_error("Could not write file: " + file_path);
+			}
+#endif
+			bytes_written += static_cast<uint64_t>(chunk_written);
+		}
+	}
+
+	// Copies byte_size bytes of the source file to target_start. On Linux copy_file_range keeps the data in the kernel
+	// (and shares extents on file systems with reflinks). Elsewhere, or if the file systems refuse, the bytes are copied through a buffer
+	void copyFrom(const PositionalFile& source, uint64_t source_start, uint64_t byte_size, uint64_t target_start)
+	{
+		uint64_t bytes_copied = 0;
+
+#if defined(__linux__)
+		while (bytes_copied < byte_size)
+		{
+			loff_t source_offset = static_cast<loff_t>(source_start + bytes_copied);
+			loff_t target_offset = static_cast<loff_t>(target_start + bytes_copied);
+			const ssize_t chunk_copied = ::copy_file_range(source.native_handle(), &source_offset, handle, &target_offset, static_cast<size_t>(byte_size - bytes_copied), 0);
+
+			if (chunk_copied < 0 && errno == EINTR) {
+				continue;
+			}
+			if (chunk_copied < 0 && (errno == ENOSYS || errno == EXDEV || errno == EINVAL || errno == EOPNOTSUPP)) {
+				break;
+			}
+			if (chunk_copied < 0) {
+				throw std::runtime_error("Could not copy into file: " + file_path);
+			}
+			if (chunk_copied == 0) {
+				throw std::runtime_error("Unexpected end of file while copying into: " + file_path);
+			}
+			bytes_copied += static_cast<uint64_t>(chunk_copied);
+		}
+#endif
+
+		std::vector<uint8_t> buffer;
+		while (bytes_copied < byte_size)
+		{
+			const uint64_t chunk = (std::min)(byte_size - bytes_copied, uint64_t(8) << 20);
+			buffer.resize(static_cast<size_t>(chunk));
+
+			const size_t chunk_read = source.readAt(source_start + bytes_copied, chunk, buffer.data());
+			if (chunk_read == 0) {
+				throw std::runtime_error("Unexpected end of file while copying into: " + file_path);
+			}
+
+			writeAt(target_start + bytes_copied, buffer.data(), chunk_read);
+			bytes_copied += chunk_read;
+		}
+	}
+};
+
+#endif
@@ -9,7 +9,7 @@
 
 #include "Geometry.h"
 #include "Buffer.h"
-#include "..\..\PotreeLoader\Constants.h"
+#include "../../PotreeLoader/Constants.h"
 
 using std::string;
 using std::unordered_map;
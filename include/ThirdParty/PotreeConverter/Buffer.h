@@ -14,6 +14,8 @@
 #include <algorithm>
 #include <thread>
 #include <cstdint>
+#include <cstring>
+#include <cstdio>
 
 using std::cout;
 using std::endl;
@@ -33,6 +35,10 @@ using std::chrono::high_resolution_clock;
 
 namespace fs = std::filesystem;
 
+#ifndef _WIN32
+#define _fseeki64 fseeko
+#endif
+
 static long long unsuck_start_time = high_resolution_clock::now().time_since_epoch().count();
 
 //static double Infinity = std::numeric_limits<double>::infinity();
@@ -541,7 +547,7 @@ T read(vector<uint8_t>& buffer, int offset) {
 
 inline string leftPad(string in, int length, const char character = ' ') {
 
-	auto reps = std::max(length - in.size(), 0ull);
+	auto reps = std::max(length - in.size(), size_t(0));
 	string result = string(reps, character) + in;
 
 	return result;
@@ -5,7 +5,7 @@
 #include <cmath>
 #include <limits>
 #include <sstream>
-#include "..\..\PotreeLoader\Constants.h"
+#include "../../PotreeLoader/Constants.h"
 
 namespace geometry
 {
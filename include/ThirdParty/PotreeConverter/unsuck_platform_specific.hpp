@@ -2,6 +2,7 @@
 //#include "unsuck.hpp"
 
 #ifdef _WIN32
+	#include <winsock2.h>
 	#include "TCHAR.h"
 	#include "pdh.h"
 	#include "windows.h"
@@ -164,4 +165,54 @@ CpuData getCpuData() {
 	return data;
 }
 
-#endif
\ No newline at end of file
+#else
+	#include <sys/sysinfo.h>
+	#include <unistd.h>
+
+MemoryData getMemoryData() {
+
+	MemoryData data;
+
+	struct sysinfo memInfo;
+	if (sysinfo(&memInfo) == 0) {
+		data.virtual_total = (memInfo.totalram + memInfo.totalswap) * memInfo.mem_unit;
+		data.virtual_used = (memInfo.totalram - memInfo.freeram + memInfo.totalswap - memInfo.freeswap) * memInfo.mem_unit;
+
+		data.physical_total = memInfo.totalram * memInfo.mem_unit;
+		data.physical_used = (memInfo.totalram - memInfo.freeram) * memInfo.mem_unit;
+	}
+
+	// /proc/self/statm reports sizes in pages: total program size, resident set size, ...
+	size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	size_t virtualPages = 0, residentPages = 0;
+	if (FILE* statm = fopen("/proc/self/statm", "r")) {
+		if (fscanf(statm, "%zu %zu", &virtualPages, &residentPages) != 2) {
+			virtualPages = residentPages = 0;
+		}
+		fclose(statm);
+	}
+
+	static size_t virtualUsedMax = 0;
+	static size_t physicalUsedMax = 0;
+
+	virtualUsedMax = std::max(virtualPages * pageSize, virtualUsedMax);
+	physicalUsedMax = std::max(residentPages * pageSize, physicalUsedMax);
+
+	data.virtual_usedByProcess = virtualPages * pageSize;
+	data.virtual_usedByProcess_max = virtualUsedMax;
+	data.physical_usedByProcess = residentPages * pageSize;
+	data.physical_usedByProcess_max = physicalUsedMax;
+
+	return data;
+}
+
+CpuData getCpuData() {
+
+	CpuData data;
+	data.numProcessors = std::thread::hardware_concurrency();
+	data.usage = 0.0;
+
+	return data;
+}
+
+#endif
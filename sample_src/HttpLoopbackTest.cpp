@@ -0,0 +1,368 @@
+// HttpLoopbackTest.cpp : Checks HttpByteSource against a range server on the loopback interface. Built on its own, it has its own main.
+// Pass the directory of a converted dataset to also compare loading it over HTTP with loading it from the local files
+#include <iostream>
+#include <map>
+#include <random>
+#include <functional>
+#include <filesystem>
+
+#include "../include/OctreeCore.h"
+
+using std::vector;
+using std::string;
+namespace fs = std::filesystem;
+
+static int failures = 0;
+
+static void Check(bool condition, const string& what)
+{
+	std::printf("%s: %s\n", condition ? "ok  " : "FAIL", what.c_str());
+	if (!condition) {
+		++failures;
+	}
+}
+
+// Minimal HTTP server serving files from memory, with modes for the responses HttpByteSource has to cope with or reject
+class LoopbackServer
+{
+public:
+	enum class Mode
+	{
+		KeepAlive,    // HTTP/1.1, connections persist
+		Http10,       // HTTP/1.0 without "Connection: keep-alive", the server closes after every response
+		ShiftedRange, // 206 with the bytes and Content-Range one byte after the requested range
+		Multipart     // 206 as multipart/byteranges, without Content-Range
+	};
+
+	std::atomic<Mode> mode{ Mode::KeepAlive };
+	std::atomic<int> connections{ 0 };
+
+private:
+	using SocketHandle = HttpConnection::SocketHandle;
+
+	std::map<string, std::shared_ptr<const vector<uint8_t>>> files;
+	SocketHandle listener = HttpConnection::InvalidSocket;
+	std::string portString;
+	std::thread acceptThread;
+	std::mutex clientMutex;
+	vector<SocketHandle> clients;
+	vector<std::thread> clientThreads;
+
+	static void CloseSocket(SocketHandle handle)
+	{
+#ifdef _WIN32
+		closesocket(handle);
+#else
+		::close(handle);
+#endif
+	}
+
+	static void ShutdownSocket(SocketHandle handle)
+	{
+#ifdef _WIN32
+		shutdown(handle, SD_BOTH);
+#else
+		shutdown(handle, SHUT_RDWR);
+#endif
+	}
+
+	static bool SendAll(SocketHandle client, const string& bytes)
+	{
+		size_t sent = 0;
+		while (sent < bytes.size())
+		{
+#ifdef MSG_NOSIGNAL
+			const auto count = send(client, bytes.data() + sent, static_cast<int>(bytes.size() - sent), MSG_NOSIGNAL);
+#else
+			const auto count = send(client, bytes.data() + sent, static_cast<int>(bytes.size() - sent), 0);
+#endif
+			if (count <= 0) {
+				return false;
+			}
+			sent += static_cast<size_t>(count);
+		}
+		return true;
+	}
+
+	// Answers one request, returns false if the connection has to be closed
+	bool Respond(SocketHandle client, const string& request)
+	{
+		const size_t methodEnd = request.find(' ');
+		const size_t pathEnd = request.find(' ', methodEnd + 1);
+		const string method = request.substr(0, methodEnd);
+		const string path = request.substr(methodEnd + 1, pathEnd - methodEnd - 1);
+
+		const Mode responseMode = mode;
+		const string statusVersion = responseMode == Mode::Http10 ? "HTTP/1.0 " : "HTTP/1.1 ";
+		const bool keepAlive = responseMode != Mode::Http10;
+
+		auto file = files.find(path);
+		if (file == files.end()) {
+			return SendAll(client, statusVersion + "404 Not Found\r\nContent-Length: 0\r\n\r\n") && keepAlive;
+		}
+
+		const auto& content = *file->second;
+		const uint64_t size = content.size();
+
+		if (method == "HEAD") {
+			return SendAll(client, statusVersion + "200 OK\r\nContent-Length: " + std::to_string(size) + "\r\n\r\n") && keepAlive;
+		}
+
+		const size_t range = request.find("\r\nRange: bytes=");
+		if (range == string::npos) {
+			return SendAll(client, statusVersion + "200 OK\r\nContent-Length: " + std::to_string(size) + "\r\n\r\n" + string(content.begin(), content.end())) && keepAlive;
+		}
+
+		uint64_t first = std::stoull(request.substr(range + 15));
+		uint64_t last = std::stoull(request.substr(request.find('-', range + 15) + 1));
+		if (first >= size) {
+			return SendAll(client, statusVersion + "416 Range Not Satisfiable\r\nContent-Length: 0\r\n\r\n") && keepAlive;
+		}
+
+		if (responseMode == Mode::ShiftedRange && last + 1 < size) {
+			++first;
+			++last;
+		}
+		last = (std::min)(last, size - 1);
+		const string body(content.begin() + first, content.begin() + last + 1);
+		const string contentRange = "bytes " + std::to_string(first) + "-" + std::to_string(last) + "/" + std::to_string(size);
+
+		if (responseMode == Mode::Multipart)
+		{
+			const string part = "--range\r\nContent-Type: application/octet-stream\r\nContent-Range: " + contentRange + "\r\n\r\n" + body + "\r\n--range--\r\n";
+			return SendAll(client, statusVersion + "206 Partial Content\r\nContent-Type: multipart/byteranges; boundary=range\r\nContent-Length: " + std::to_string(part.size()) + "\r\n\r\n" + part) && keepAlive;
+		}
+
+		return SendAll(client, statusVersion + "206 Partial Content\r\nContent-Range: " + contentRange + "\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body) && keepAlive;
+	}
+
+	void HandleClient(SocketHandle client)
+	{
+		string received;
+		char buffer[4096];
+		while (true)
+		{
+			const size_t headEnd = received.find("\r\n\r\n");
+			if (headEnd != string::npos)
+			{
+				const string request = received.substr(0, headEnd + 2);
+				received.erase(0, headEnd + 4);
+				if (!Respond(client, request)) {
+					break;
+				}
+				continue;
+			}
+
+			const auto count = recv(client, buffer, sizeof(buffer), 0);
+			if (count <= 0) {
+				break;
+			}
+			received.append(buffer, static_cast<size_t>(count));
+		}
+		ShutdownSocket(client);
+	}
+
+public:
+	LoopbackServer()
+	{
+#ifdef _WIN32
+		WSADATA data;
+		WSAStartup(MAKEWORD(2, 2), &data);
+#endif
+		listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		sockaddr_in address{};
+		address.sin_family = AF_INET;
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		address.sin_port = 0;
+		socklen_t length = sizeof(address);
+		if (listener == HttpConnection::InvalidSocket
+			|| bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+			|| listen(listener, 16) != 0
+			|| getsockname(listener, reinterpret_cast<sockaddr*>(&address), &length) != 0)
+		{
+			throw std::runtime_error("Cannot listen on the loopback interface");
+		}
+		portString = std::to_string(ntohs(address.sin_port));
+
+		acceptThread = std::thread([this]() {
+			while (true)
+			{
+				SocketHandle client = accept(listener, nullptr, nullptr);
+				if (client == HttpConnection::InvalidSocket) {
+					return;
+				}
+				++connections;
+				std::lock_guard<std::mutex> lock(clientMutex);
+				clients.push_back(client);
+				clientThreads.emplace_back(&LoopbackServer::HandleClient, this, client);
+			}
+			});
+	}
+
+	~LoopbackServer()
+	{
+		ShutdownSocket(listener);
+		CloseSocket(listener);
+		acceptThread.join();
+		for (auto client : clients) {
+			ShutdownSocket(client);
+		}
+		for (auto& thread : clientThreads) {
+			thread.join();
+		}
+		for (auto client : clients) {
+			CloseSocket(client);
+		}
+#ifdef _WIN32
+		WSACleanup();
+#endif
+	}
+
+	// Adds a file while no request is in flight, the files are not guarded against concurrent changes
+	void Serve(const string& path, vector<uint8_t> content)
+	{
+		files[path] = std::make_shared<const vector<uint8_t>>(std::move(content));
+	}
+
+	string Url(const string& path) const
+	{
+		return "http://127.0.0.1:" + portString + path;
+	}
+};
+
+static bool ReadsMatch(const ByteSource& source, const vector<uint8_t>& expected, std::mt19937& random, int count)
+{
+	vector<uint8_t> buffer;
+	for (int i = 0; i < count; ++i)
+	{
+		const uint64_t start = random() % expected.size();
+		const uint64_t size = 1 + random() % 70000;
+		buffer.assign(static_cast<size_t>(size), 0);
+
+		const size_t bytes_read = source.ReadAt(start, size, buffer.data());
+		const size_t expected_size = static_cast<size_t>((std::min)(size, expected.size() - start));
+		if (bytes_read != expected_size || !std::equal(buffer.begin(), buffer.begin() + expected_size, expected.begin() + start)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool Throws(const std::function<void()>& function)
+{
+	try {
+		function();
+	}
+	catch (const std::exception&) {
+		return true;
+	}
+	return false;
+}
+
+// Sum over the data of all nodes, weighted by position so swapped bytes are noticed
+static uint64_t NodeChecksum(Octree& octree)
+{
+	OctreeLoader loader(&octree);
+	uint64_t checksum = 0;
+	AsyncReadOptions readOptions;
+	readOptions.queueDepth = 8;
+	loader.LoadNodeBatch(octree.TraversableNodeReferences(), [&checksum](OctreeGeometryNode*, const uint8_t* data, size_t size) {
+		for (size_t i = 0; i < size; ++i) {
+			checksum += data[i] * (i + 1);
+		}
+		}, readOptions);
+	return checksum;
+}
+
+static vector<uint8_t> ReadFile(const string& path)
+{
+	return FileByteSource(path).ReadAll();
+}
+
+//----------------------------------------------------------------------------------------------
+int main(int argc, char** argv) {
+
+	vector<uint8_t> content(3 * 1024 * 1024 + 17);
+	std::mt19937 random(42);
+	for (auto& byte : content) {
+		byte = static_cast<uint8_t>(random());
+	}
+
+	const HttpUrl ipv6 = HttpUrl::Parse("http://[::1]:8080/datasets/octree.bin");
+	const HttpUrl ipv6DefaultPort = HttpUrl::Parse("http://[::1]/octree.bin");
+	Check(ipv6.host == "::1" && ipv6.port == "8080" && ipv6.path == "/datasets/octree.bin", "IPv6 host and port from the URL");
+	Check(ipv6DefaultPort.host == "::1" && ipv6DefaultPort.port == "80", "IPv6 host with the default port");
+
+	LoopbackServer server;
+	server.Serve("/content.bin", content);
+
+	{
+		HttpSourceOptions options;
+		options.maxConnections = 4;
+		HttpByteSource source(server.Url("/content.bin"), options);
+		Check(source.Size() == content.size(), "size from HEAD");
+		Check(ReadsMatch(source, content, random, 200), "single range requests");
+
+		vector<uint8_t> tail(100);
+		Check(source.ReadAt(content.size() - 10, 100, tail.data()) == 10, "range clamped to the end of the file");
+		Check(source.ReadAt(content.size(), 100, tail.data()) == 0, "range after the end of the file");
+
+		vector<AsyncReadRequest> requests;
+		for (uint64_t i = 0; i < 64; ++i) {
+			requests.push_back({ i * 40000, 40000, static_cast<size_t>(i) });
+		}
+		bool batchMatches = true;
+		AsyncReadOptions readOptions;
+		readOptions.queueDepth = 8;
+		source.Read(requests, [&](size_t id, const uint8_t* data, size_t size) {
+			batchMatches = batchMatches && size == 40000 && std::equal(data, data + size, content.begin() + id * 40000);
+			}, readOptions);
+		Check(batchMatches, "parallel batch of range requests");
+		Check(server.connections <= 4, "connections are reused, " + std::to_string(server.connections) + " opened for 266 requests");
+	}
+
+	server.mode = LoopbackServer::Mode::Http10;
+	{
+		const int connectionsBefore = server.connections;
+		HttpByteSource source(server.Url("/content.bin"));
+		Check(ReadsMatch(source, content, random, 20), "HTTP/1.0 range requests");
+		Check(server.connections - connectionsBefore == 21, "one connection per HTTP/1.0 request");
+	}
+
+	server.mode = LoopbackServer::Mode::ShiftedRange;
+	{
+		HttpByteSource source(server.Url("/content.bin"));
+		vector<uint8_t> buffer(1000);
+		Check(Throws([&]() { source.ReadAt(1000, 1000, buffer.data()); }), "shifted Content-Range is rejected");
+	}
+
+	server.mode = LoopbackServer::Mode::Multipart;
+	{
+		HttpByteSource source(server.Url("/content.bin"));
+		vector<uint8_t> buffer(1000);
+		Check(Throws([&]() { source.ReadAt(1000, 1000, buffer.data()); }), "multipart/byteranges response is rejected");
+	}
+
+	server.mode = LoopbackServer::Mode::KeepAlive;
+	Check(Throws([&]() { HttpByteSource source(server.Url("/missing.bin")); }), "missing file is an error");
+
+	if (argc > 1)
+	{
+		// Loading a dataset over HTTP has to give the same node data as loading it locally
+		auto octreeFiles = octree_files::SearchOctreeFiles(argv[1]);
+		server.Serve("/metadata.json", ReadFile(octreeFiles["metadata"]));
+		server.Serve("/hierarchy.bin", ReadFile(octreeFiles["hierarchy"]));
+		server.Serve("/octree.bin", ReadFile(octreeFiles["octree"]));
+
+		Octree local(octreeFiles["metadata"]);
+		Octree remote;
+		remote.LoadFromByteSources(std::make_shared<HttpByteSource>(server.Url("/metadata.json")),
+			std::make_shared<HttpByteSource>(server.Url("/hierarchy.bin")), std::make_shared<HttpByteSource>(server.Url("/octree.bin")));
+
+		Check(remote.geometry.nodes.size() == local.geometry.nodes.size(), "dataset hierarchy over HTTP");
+		Check(NodeChecksum(remote) == NodeChecksum(local), "dataset node data over HTTP");
+	}
+
+	std::printf("%d checks failed\n", failures);
+	return failures == 0 ? 0 : 1;
+}
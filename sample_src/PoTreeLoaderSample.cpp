@@ -22,7 +22,7 @@ struct PointCloudItem {
 //----------------------------------------------------------------------------------------------
 int main(int argc, char** argv) {
 
-	int64_t maxLevel = 10; // The max depth we load data from in this test
+	int maxLevel = 10; // The max depth we load data from in this test
 
 	// Directory path to PoTree converted data
 	auto current_path = fs::current_path();
@@ -66,14 +66,9 @@ int main(int argc, char** argv) {
 	std::vector<PointCloudItem> cloudpoints;
 	cloudpoints.reserve(octree.points);
 
-	// Start reading and extracting until max level
+	// Start reading and extracting until max level. Deeper nodes are not visited at all
 	octree.geometry.nodes[0]->traverse(
-		[maxLevel, &loader, &nodeData, bytesPerPoint, scale, offset, pos_index, int_index, rgb_index, &cloudpoints, hasRGB, hasIntensity](OctreeGeometryNode* node, int level) {
-
-			if (node->level > maxLevel)
-			{
-				return;
-			}
+		[&loader, &nodeData, bytesPerPoint, scale, offset, pos_index, int_index, rgb_index, &cloudpoints, hasRGB, hasIntensity](OctreeGeometryNode* node, int level) {
 
 			//auto data = loader.LoadNodeData(node); // Create new node data object with a new buffer every iteration
 			auto& data = loader.LoadNodeData(node, nodeData); // Reuse the node data object's buffer
@@ -111,7 +106,7 @@ int main(int argc, char** argv) {
 
 				cloudpoints.emplace_back(x, y, z, r, g, b, intensity);
 			}
-		});
+		}, LevelRange::UpTo(maxLevel));
 
 	std::printf("Finished loading %zd points from octree data!\n", cloudpoints.size());
 